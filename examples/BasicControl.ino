@@ -5,6 +5,15 @@ StepperController controller;
 char cmdBuffer[COMMAND_BUFFER_SIZE];
 int cmdIndex = 0;
 
+bool cmdWhere(StepperController& controller, CommandArgs& args) {
+  Output.print(F("Motor "));
+  Output.print(args.motor);
+  Output.print(F(" at "));
+  Output.print(controller.getMotor(args.motor)->getCurrentPositionUnit());
+  Output.println(F(" units"));
+  return true;
+}
+
 void setup() {
   Serial.begin(SERIAL_BAUD_RATE);
   Serial.println(F("Basic Stepper Control Example"));
@@ -17,6 +26,8 @@ void setup() {
   motor->setAcceleration(DEFAULT_ACCELERATION);
   motor->setStepsPerUnit(DEFAULT_STEPS_PER_UNIT);
   
+  controller.registerCommand("where", "m", cmdWhere, "where <motor> - Show motor position in units");
+  
   Serial.println(F("Motor initialized"));
   Serial.println(F("Use 'move 0 100' to move 100 steps"));
   
@@ -32,14 +43,19 @@ void processSerialInput() {
   while (Serial.available() > 0) {
     char c = Serial.read();
     
+    if (controller.isBinaryMode()) {
+      controller.processBinaryByte(c);
+      continue;
+    }
+    
     if (c == '\n' || c == '\r') {
       if (cmdIndex > 0) {
         cmdBuffer[cmdIndex] = '\0';
         
         if (!controller.processCommand(cmdBuffer)) {
-          Serial.print(F("Invalid command: "));
-          Serial.println(cmdBuffer);
-          Serial.println(F("Type 'help' for available commands"));
+          Output.print(F("Invalid command: "));
+          Output.println(cmdBuffer);
+          Verbose.println(F("Type 'help' for available commands"));
         }
         
         cmdIndex = 0;
@@ -48,12 +64,12 @@ void processSerialInput() {
     else if (c == 8 || c == 127) {
       if (cmdIndex > 0) {
         cmdIndex--;
-        Serial.print(F("\b \b"));
+        Verbose.print(F("\b \b"));
       }
     }
     else if (cmdIndex < COMMAND_BUFFER_SIZE - 1) {
       cmdBuffer[cmdIndex++] = c;
-      Serial.write(c);
+      Verbose.write(c);
     }
   }
 }
@@ -0,0 +1,227 @@
+#include "../inc/StepperController.hpp"
+
+// Step throughput, update() period and command cost, printed as CSV:
+//   metric,key,value,unit
+// Replies from the commands under test are interleaved; keep lines starting with
+// a lowercase metric name. Runs once at startup. Motor outputs toggle at full rate; leave the drivers disabled.
+// Built for the host with `make host_bench`, where times are virtual and deterministic.
+
+#define BENCH_WINDOW_MS 1000
+#define BENCH_SPEED 20000.0
+#define BENCH_ACCELERATION 200000.0
+#define BENCH_DISTANCE 1000000L
+#define BENCH_COMMAND_REPEAT 50
+
+StepperController controller;
+
+// Extra motors beyond X/Y/Z/A use the E1 socket and AUX header pins
+uint8_t addBenchMotor(uint8_t index) {
+  switch (index) {
+    case 0: return controller.addMotor<X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN>();
+    case 1: return controller.addMotor<Y_STEP_PIN, Y_DIR_PIN, Y_ENABLE_PIN>();
+    case 2: return controller.addMotor<Z_STEP_PIN, Z_DIR_PIN, Z_ENABLE_PIN>();
+    case 3: return controller.addMotor<A_STEP_PIN, A_DIR_PIN, A_ENABLE_PIN>();
+    case 4: return controller.addMotor<36, 34, 30>();
+    case 5: return controller.addMotor<40, 42, 44>();
+    case 6: return controller.addMotor<57, 58, 59>();
+    default: return controller.addMotor<63, 64, 65>();
+  }
+}
+
+void printResult(const __FlashStringHelper* metric, const char* key, unsigned long value, const __FlashStringHelper* unit) {
+  Serial.print(metric);
+  Serial.print(',');
+  Serial.print(key);
+  Serial.print(',');
+  Serial.print(value);
+  Serial.print(',');
+  Serial.println(unit);
+}
+
+long totalSteps() {
+  long steps = 0;
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    steps += labs(controller.getMotor(i)->getCurrentPosition());
+  }
+  return steps;
+}
+
+void stopAll() {
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    controller.getMotor(i)->stop();
+  }
+  
+  bool running = true;
+  while (running) {
+    controller.update();
+    
+    running = false;
+    for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+      if (controller.getMotor(i)->isRunning()) running = true;
+    }
+  }
+}
+
+// Every motor asks for more than the loop can deliver; count what actually comes out
+void measureThroughput() {
+  uint8_t count = controller.getMotorCount();
+  long startSteps = totalSteps();
+  
+  for (uint8_t i = 0; i < count; i++) {
+    Motor* motor = controller.getMotor(i);
+    motor->moveTo(motor->getCurrentPosition() + BENCH_DISTANCE);
+  }
+  
+  unsigned long maxPeriod = 0;
+  unsigned long maxUpdate = 0;
+  unsigned long start = micros();
+  unsigned long last = start;
+  
+  while (last - start < BENCH_WINDOW_MS * 1000UL) {
+    unsigned long before = micros();
+    controller.update();
+    unsigned long after = micros();
+    
+    if (after - before > maxUpdate) maxUpdate = after - before;
+    if (after - last > maxPeriod) maxPeriod = after - last;
+    last = after;
+  }
+  
+  long steps = totalSteps() - startSteps;
+  stopAll();
+  
+  char key[4];
+  snprintf(key, sizeof(key), "%u", count);
+  printResult(F("steps_per_s"), key, steps * 1000L / BENCH_WINDOW_MS, F("steps/s"));
+  printResult(F("update_max"), key, maxUpdate, F("us"));
+  printResult(F("period_max"), key, maxPeriod, F("us"));
+}
+
+// Only the first motor moves; idle motors should cost nothing per update
+void measureSingleActive() {
+  Motor* motor = controller.getMotor(0);
+  motor->moveTo(motor->getCurrentPosition() + BENCH_DISTANCE);
+  
+  unsigned long total = 0;
+  unsigned long updates = 0;
+  unsigned long start = micros();
+  
+  while (micros() - start < BENCH_WINDOW_MS * 1000UL) {
+    unsigned long before = micros();
+    controller.update();
+    total += micros() - before;
+    updates++;
+  }
+  
+  stopAll();
+  
+  char key[4];
+  snprintf(key, sizeof(key), "%u", controller.getMotorCount());
+  printResult(F("update_avg_one_active"), key, total / updates, F("us"));
+}
+
+// Average and worst cost of one processCommand() call; replies are flushed outside the timing
+void measureCommand(const char* command) {
+  unsigned long total = 0;
+  unsigned long worst = 0;
+  
+  for (uint8_t i = 0; i < BENCH_COMMAND_REPEAT; i++) {
+    unsigned long start = micros();
+    controller.processCommand(command);
+    unsigned long elapsed = micros() - start;
+    
+    total += elapsed;
+    if (elapsed > worst) worst = elapsed;
+    Output.flush();
+  }
+  
+  char key[24];
+  strncpy(key, command, sizeof(key) - 1);
+  key[sizeof(key) - 1] = '\0';
+  char* space = strchr(key, ' ');
+  if (space) *space = '\0';
+  
+  printResult(F("command_avg"), key, total / BENCH_COMMAND_REPEAT, F("us"));
+  printResult(F("command_max"), key, worst, F("us"));
+  printResult(F("link_per_s"), key, SERIAL_BAUD_RATE / 10 / (strlen(command) + 1), F("commands/s"));
+}
+
+// The same for a binary frame fed a byte at a time, with the frame rate the
+// serial link can carry for comparison against the text line
+void measureFrame(const char* key, uint8_t opcode, const uint8_t* payload, uint8_t length) {
+  uint8_t frame[BINARY_MAX_PAYLOAD + 5];
+  uint8_t size = BinaryProtocol::encode(frame, opcode, payload, length);
+  unsigned long total = 0;
+  unsigned long worst = 0;
+  
+  controller.setBinaryMode(true);
+  for (uint8_t i = 0; i < BENCH_COMMAND_REPEAT; i++) {
+    unsigned long start = micros();
+    for (uint8_t j = 0; j < size; j++) {
+      controller.processBinaryByte(frame[j]);
+    }
+    unsigned long elapsed = micros() - start;
+    
+    total += elapsed;
+    if (elapsed > worst) worst = elapsed;
+    Output.flush();
+  }
+  controller.setBinaryMode(false);
+  
+  // Binary replies carry no line ending; start the results on a fresh line
+  Serial.println();
+  printResult(F("frame_avg"), key, total / BENCH_COMMAND_REPEAT, F("us"));
+  printResult(F("frame_max"), key, worst, F("us"));
+  printResult(F("link_per_s"), key, SERIAL_BAUD_RATE / 10 / size, F("commands/s"));
+}
+
+void measurePrintStatus() {
+  unsigned long total = 0;
+  
+  for (uint8_t i = 0; i < BENCH_COMMAND_REPEAT; i++) {
+    unsigned long start = micros();
+    controller.printStatus();
+    total += micros() - start;
+    Output.flush();
+  }
+  
+  printResult(F("print_status_avg"), "all", total / BENCH_COMMAND_REPEAT, F("us"));
+}
+
+// Setup
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.println(F("metric,key,value,unit"));
+  
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+    Motor* motor = controller.getMotor(addBenchMotor(i));
+    motor->setMaxSpeed(BENCH_SPEED);
+    motor->setAcceleration(BENCH_ACCELERATION);
+    
+    measureThroughput();
+    measureSingleActive();
+  }
+  
+  controller.processCommand("quiet 1");
+  measureCommand("speed 0 1000");
+  measureCommand("accel 0 500");
+  measureCommand("moveto 0 0");
+  measureCommand("stop 0");
+  char queue[COMMAND_BUFFER_SIZE] = "queue";
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    strcat(queue, " 0");
+  }
+  measureCommand(queue);
+  measureCommand("pose 0 0 0");
+  measureCommand("nosuchcommand");
+  
+  uint8_t moveTo[5] = {0};
+  measureFrame("op_move_to", OP_MOVE_TO, moveTo, sizeof(moveTo));
+  measureFrame("op_ping", OP_PING, NULL, 0);
+  measurePrintStatus();
+  
+  stopAll();
+}
+
+void loop() {
+}
@@ -0,0 +1,79 @@
+#include "../inc/StepperController.hpp"
+
+StepperController controller;
+
+bool blockingOutput = false;
+unsigned long lastLoop = 0;
+unsigned long lastCommand = 0;
+unsigned long lastReport = 0;
+unsigned long maxPeriod = 0;
+unsigned long totalPeriod = 0;
+unsigned long loopCount = 0;
+
+// Setup
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.println(F("Loop Jitter Example"));
+  Serial.println(F("b: buffered output (default)"));
+  Serial.println(F("d: blocking output, flushed after every reply"));
+  
+  uint8_t motorIndex = controller.addMotor(X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN, MOTOR_INTERFACE_TYPE);
+  
+  Motor* motor = controller.getMotor(motorIndex);
+  motor->setMaxSpeed(DEFAULT_MAX_SPEED);
+  motor->setAcceleration(DEFAULT_ACCELERATION);
+  
+  lastLoop = micros();
+}
+
+void loop() {
+  // Measure the time since the previous iteration
+  unsigned long now = micros();
+  unsigned long period = now - lastLoop;
+  lastLoop = now;
+  
+  if (period > maxPeriod) maxPeriod = period;
+  totalPeriod += period;
+  loopCount++;
+  
+  if (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == 'b') blockingOutput = false;
+    if (c == 'd') blockingOutput = true;
+  }
+  
+  // Keep the motor moving back and forth
+  Motor* motor = controller.getMotor(0);
+  if (!motor->isRunning()) {
+    motor->moveTo(motor->getCurrentPosition() > 0 ? -2000 : 2000);
+  }
+  
+  // Produce the same chatter as a host polling for status
+  if (millis() - lastCommand >= 50) {
+    lastCommand = millis();
+    controller.processCommand("status");
+    
+    if (blockingOutput) {
+      Output.flush();
+    }
+  }
+  
+  // Report loop statistics every two seconds
+  if (millis() - lastReport >= 2000) {
+    lastReport = millis();
+    
+    Output.print(blockingOutput ? F("blocking") : F("buffered"));
+    Output.print(F(" avg_us="));
+    Output.print(totalPeriod / loopCount);
+    Output.print(F(" max_us="));
+    Output.print(maxPeriod);
+    Output.print(F(" dropped="));
+    Output.println(Output.getDropped());
+    
+    maxPeriod = 0;
+    totalPeriod = 0;
+    loopCount = 0;
+  }
+  
+  controller.update();
+}
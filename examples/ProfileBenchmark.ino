@@ -0,0 +1,105 @@
+#include "../inc/MotionProfile.hpp"
+#include "../inc/FixedProfile.hpp"
+
+#define BENCH_MAX_SPEED 4000.0
+#define BENCH_ACCELERATION 8000.0
+#define BENCH_DISTANCE 20000L
+#define BENCH_PERIOD_US 100
+
+MotionProfile floatProfile;
+FixedProfile fixedProfile;
+
+// Runs one full move with the float profile and returns the number of updates
+unsigned long runFloat() {
+  float position = 0.0;
+  unsigned long updates = 0;
+  floatProfile.reset();
+  
+  do {
+    float speed = floatProfile.update(BENCH_DISTANCE - (long)position, BENCH_PERIOD_US * 1.0e-6);
+    position += speed * (BENCH_PERIOD_US * 1.0e-6);
+    updates++;
+  } while (floatProfile.getSpeed() != 0.0);
+  
+  return updates;
+}
+
+// Same move with the fixed-point profile; position is tracked in Q16.16 steps
+unsigned long runFixed() {
+  int64_t position = 0;
+  unsigned long updates = 0;
+  fixedProfile.resetFixed(0);
+  
+  do {
+    fixed_t speed = fixedProfile.updateFixed(BENCH_DISTANCE - (long)(position >> 16), BENCH_PERIOD_US);
+    position += ((int64_t)speed * BENCH_PERIOD_US) / 1000000L;
+    updates++;
+  } while (fixedProfile.getSpeedFixed() != 0);
+  
+  return updates;
+}
+
+// Steps both profiles in lockstep and reports the largest speed difference
+float compareProfiles() {
+  float position = 0.0;
+  float maxError = 0.0;
+  floatProfile.reset();
+  fixedProfile.resetFixed(0);
+  
+  for (unsigned long i = 0; i < 100000UL; i++) {
+    long remaining = BENCH_DISTANCE - (long)position;
+    float speed = floatProfile.update(remaining, BENCH_PERIOD_US * 1.0e-6);
+    float fixedSpeed = fixedToFloat(fixedProfile.updateFixed(remaining, BENCH_PERIOD_US));
+    
+    if (fabs(speed - fixedSpeed) > maxError) maxError = fabs(speed - fixedSpeed);
+    position += speed * (BENCH_PERIOD_US * 1.0e-6);
+    
+    if (speed == 0.0) break;
+  }
+  
+  return maxError;
+}
+
+void report(const __FlashStringHelper* name, unsigned long updates, unsigned long elapsed) {
+  Serial.print(name);
+  Serial.print(F(" updates="));
+  Serial.print(updates);
+  Serial.print(F(" us="));
+  Serial.print(elapsed);
+  Serial.print(F(" cycles_per_update="));
+  Serial.println((float)elapsed * (F_CPU / 1000000L) / updates);
+}
+
+void runBenchmark() {
+  unsigned long start = micros();
+  unsigned long updates = runFloat();
+  report(F("float"), updates, micros() - start);
+  
+  start = micros();
+  updates = runFixed();
+  report(F("fixed"), updates, micros() - start);
+  
+  Serial.print(F("max_speed_error="));
+  Serial.println(compareProfiles());
+}
+
+// Setup
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.println(F("Profile Benchmark Example"));
+  Serial.println(F("Send any character to run again"));
+  
+  floatProfile.setMaxSpeed(BENCH_MAX_SPEED);
+  floatProfile.setAcceleration(BENCH_ACCELERATION);
+  fixedProfile.setMaxSpeed(BENCH_MAX_SPEED);
+  fixedProfile.setAcceleration(BENCH_ACCELERATION);
+  
+  runBenchmark();
+}
+
+void loop() {
+  if (Serial.available() > 0) {
+    Serial.read();
+    runBenchmark();
+  }
+}
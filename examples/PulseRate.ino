@@ -0,0 +1,62 @@
+#include "../inc/StepperController.hpp"
+
+#define PULSE_COUNT 10000
+#define RUN_TIME_MS 1000
+
+PinDriver slowDriver(X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN);
+FastPinDriver<X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN> fastDriver;
+
+// Back-to-back step pulses straight through a driver
+void measurePulses(const __FlashStringHelper* name, PinDriver& driver) {
+  unsigned long start = micros();
+  for (uint16_t i = 0; i < PULSE_COUNT; i++) {
+    driver.step(true);
+  }
+  unsigned long elapsed = micros() - start;
+  
+  Serial.print(name);
+  Serial.print(F(" pulses="));
+  Serial.print(PULSE_COUNT);
+  Serial.print(F(" us="));
+  Serial.print(elapsed);
+  Serial.print(F(" pulses_per_s="));
+  Serial.println((unsigned long)(PULSE_COUNT * 1000000.0 / elapsed));
+}
+
+// Highest step rate AccelStepper::runSpeed reaches when asked for more than it can do
+void measureStepper(const __FlashStringHelper* name, AccelStepper& stepper) {
+  stepper.setCurrentPosition(0);
+  stepper.setMaxSpeed(100000.0);
+  stepper.setSpeed(100000.0);
+  
+  unsigned long start = millis();
+  while (millis() - start < RUN_TIME_MS) {
+    stepper.runSpeed();
+  }
+  
+  Serial.print(name);
+  Serial.print(F(" steps_per_s="));
+  Serial.println(stepper.currentPosition() * 1000L / RUN_TIME_MS);
+}
+
+// Setup
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  Serial.println(F("Pulse Rate Example"));
+  Serial.println(F("Motor outputs toggle at full rate; leave the drivers disabled"));
+  
+  slowDriver.begin();
+  fastDriver.begin();
+  
+  measurePulses(F("digitalWrite"), slowDriver);
+  measurePulses(F("port"), fastDriver);
+  
+  AccelStepper slowStepper(AccelStepper::DRIVER, X_STEP_PIN, X_DIR_PIN);
+  DriverStepper fastStepper(&fastDriver, X_STEP_PIN, X_DIR_PIN);
+  
+  measureStepper(F("accelstepper_digitalWrite"), slowStepper);
+  measureStepper(F("accelstepper_port"), fastStepper);
+}
+
+void loop() {
+}
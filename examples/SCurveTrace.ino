@@ -0,0 +1,78 @@
+#include "../inc/StepperController.hpp"
+
+#define TRACE_STEPS 400
+#define TRACE_SPEED 2000.0
+#define TRACE_ACCELERATION 8000.0
+#define TRACE_JERK 100000.0
+
+StepperController controller;
+
+uint16_t intervals[TRACE_STEPS];
+
+// Moves motor 0 by TRACE_STEPS and records the time between consecutive steps
+void traceMove(float jerk) {
+  Motor* motor = controller.getMotor(0);
+  motor->setJerk(jerk);
+  
+  long start = motor->getCurrentPosition();
+  long last = start;
+  uint16_t count = 0;
+  unsigned long lastStep = micros();
+  unsigned long begin = lastStep;
+  
+  motor->moveTo(start + TRACE_STEPS);
+  
+  while (motor->isRunning()) {
+    controller.update();
+    
+    long position = motor->getCurrentPosition();
+    if (position != last) {
+      unsigned long now = micros();
+      if (count < TRACE_STEPS) {
+        intervals[count++] = (now - lastStep) > 0xFFFF ? 0xFFFF : (uint16_t)(now - lastStep);
+      }
+      lastStep = now;
+      last = position;
+    }
+  }
+  
+  // One CSV row per step: profile, step, time since start, interval
+  unsigned long time = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    time += intervals[i];
+    Serial.print(jerk > 0.0 ? F("scurve,") : F("trapezoid,"));
+    Serial.print(i);
+    Serial.print(',');
+    Serial.print(time);
+    Serial.print(',');
+    Serial.println(intervals[i]);
+  }
+  
+  Serial.print(F("# total_us="));
+  Serial.println(lastStep - begin);
+  
+  motor->moveTo(start);
+  while (motor->isRunning()) {
+    controller.update();
+  }
+}
+
+// Setup
+void setup() {
+  Serial.begin(SERIAL_BAUD_RATE);
+  
+  uint8_t motorIndex = controller.addMotor(X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN, MOTOR_INTERFACE_TYPE);
+  
+  Motor* motor = controller.getMotor(motorIndex);
+  motor->setMaxSpeed(TRACE_SPEED);
+  motor->setAcceleration(TRACE_ACCELERATION);
+  
+  Output.setQuiet(true);
+  
+  Serial.println(F("profile,step,time_us,interval_us"));
+  traceMove(0.0);
+  traceMove(TRACE_JERK);
+}
+
+void loop() {
+}
@@ -1,4 +1,4 @@
-#include "../inc/StepperController.h"
+#include "../inc/StepperController.hpp"
 
 #define X_STEP_PIN     54
 #define X_DIR_PIN      55
@@ -53,14 +53,26 @@ void setup() {
   controller.getMotor(zMotor)->setAcceleration(250.0);
   controller.getMotor(zMotor)->setLimits(-800, 800, true);
   
-  // Home all motors
+  // RAMPS min endstops
+  controller.getMotor(xMotor)->setLimitSwitch(X_LIMIT_PIN);
+  controller.getMotor(yMotor)->setLimitSwitch(Y_LIMIT_PIN);
+  controller.getMotor(zMotor)->setLimitSwitch(Z_LIMIT_PIN);
+  
+  // Home all motors together
   Serial.println(F("Homing all motors..."));
   controller.homeAll();
   
-  // Wait for homing to complete
+  // Homing steps on every update, so don't delay here
   while (controller.isAnyRunning()) {
     controller.update();
-    delay(10);
+  }
+  
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    if (controller.getMotor(i)->getState() == ERROR) {
+      Serial.print(F("Motor "));
+      Serial.print(i);
+      Serial.println(F(" failed to home"));
+    }
   }
   
   Serial.println(F("All motors homed. Ready for commands."));
@@ -110,18 +122,8 @@ void printMenu() {
 }
 
 // Start a synchronized movement
+// A movement already in progress is blended into the new one without stopping
 void startMovement(MovementType movement) {
-  // Reset all motors to home position if needed
-  if (movementActive) {
-    controller.stopAll();
-    
-    // Wait for motors to stop
-    while (controller.isAnyRunning()) {
-      controller.update();
-      delay(10);
-    }
-  }
-  
   currentMovement = movement;
   moveStartTime = millis();
   movementActive = true;
@@ -154,35 +156,32 @@ void startMovement(MovementType movement) {
 
 // === Movement Implementations ===
 
-// Linear movement - moves X and Y simultaneously at same speed
+// Linear movement - moves X and Y together along a straight line
 void executeLinearMovement() {
-  Motor* motorX = controller.getMotor(xMotor);
-  Motor* motorY = controller.getMotor(yMotor);
+  long targets[3];
+  targets[xMotor] = 1000;
+  targets[yMotor] = 1000;
+  targets[zMotor] = controller.getMotor(zMotor)->getCurrentPosition();
   
-  // Set same speed for both motors
-  motorX->setMaxSpeed(1000.0);
-  motorY->setMaxSpeed(1000.0);
-  
-  // Move to target - both will arrive at same time due to synchronized acceleration
-  motorX->moveTo(1000);
-  motorY->moveTo(1000);
+  // One master profile drives every axis, so X and Y start and finish together
+  controller.moveToAll(targets);
 }
 
-// Diagonal movement - moves X, Y, and Z simultaneously at calculated speeds
+// Diagonal movement - moves X, Y, and Z together along a straight line
 void executeDiagonalMovement() {
-  Motor* motorX = controller.getMotor(xMotor);
-  Motor* motorY = controller.getMotor(yMotor);
-  Motor* motorZ = controller.getMotor(zMotor);
-  
-  // Set speeds proportionally to distances
-  motorX->setMaxSpeed(1000.0);
-  motorY->setMaxSpeed(1000.0);
-  motorZ->setMaxSpeed(500.0);  // Z moves half as far, so half the speed
+  long targets[3];
+  targets[xMotor] = 1000;
+  targets[yMotor] = 1000;
+  targets[zMotor] = 500;  // Half the distance, stepped at half the rate
   
-  // Move to target
-  motorX->moveTo(1000);
-  motorY->moveTo(1000);
-  motorZ->moveTo(500);  // Half the distance
+  controller.moveToAll(targets);
+}
+
+// Wait for the current coordinated move to finish
+void waitForMovement() {
+  while (controller.isAnyRunning()) {
+    controller.update();
+  }
 }
 
 // Circular movement - moves X and Y in a circle
@@ -191,51 +190,31 @@ void executeCircularMovement() {
   // For a true circle you would need to generate many small movements
   // in a loop or use a more advanced control algorithm
   
-  Motor* motorX = controller.getMotor(xMotor);
-  Motor* motorY = controller.getMotor(yMotor);
+  long z = controller.getMotor(zMotor)->getCurrentPosition();
   
   // For this simple demo, we'll just move to 4 points in sequence
   // that approximate a circle
   
   Serial.println(F("Starting circular movement (approximated with 4 points)"));
   
-  // Set same speed for both motors
-  motorX->setMaxSpeed(1000.0);
-  motorY->setMaxSpeed(1000.0);
-  
   // Move to first quarter of circle (X+, Y0)
-  motorX->moveTo(800);
-  motorY->moveTo(0);
-  
-  // Wait for completion
-  while (controller.isAnyRunning()) {
-    controller.update();
-    delay(10);
-  }
+  long first[3] = {800, 0, z};
+  controller.moveToAll(first);
+  waitForMovement();
   
   // Move to second quarter (X0, Y+)
-  motorX->moveTo(0);
-  motorY->moveTo(800);
-  
-  // Wait for completion
-  while (controller.isAnyRunning()) {
-    controller.update();
-    delay(10);
-  }
+  long second[3] = {0, 800, z};
+  controller.moveToAll(second);
+  waitForMovement();
   
   // Move to third quarter (X-, Y0)
-  motorX->moveTo(-800);
-  motorY->moveTo(0);
-  
-  // Wait for completion
-  while (controller.isAnyRunning()) {
-    controller.update();
-    delay(10);
-  }
+  long third[3] = {-800, 0, z};
+  controller.moveToAll(third);
+  waitForMovement();
   
   // Move to fourth quarter (X0, Y-)
-  motorX->moveTo(0);
-  motorY->moveTo(-800);
+  long fourth[3] = {0, -800, z};
+  controller.moveToAll(fourth);
   
   // Note: We don't need to wait for completion of the last segment
   // since the main loop will detect when all motors have stopped
@@ -246,55 +225,27 @@ void executeSpiralMovement() {
   // This is a demonstration of a concept
   // A true spiral would need many small coordinated movements
   
-  Motor* motorX = controller.getMotor(xMotor);
-  Motor* motorY = controller.getMotor(yMotor);
-  Motor* motorZ = controller.getMotor(zMotor);
-  
   Serial.println(F("Starting spiral movement (approximated with 4 points)"));
   
-  // Set speeds
-  motorX->setMaxSpeed(1000.0);
-  motorY->setMaxSpeed(1000.0);
-  motorZ->setMaxSpeed(250.0);  // Z moves more slowly
-  
   // First point
-  motorX->moveTo(800);
-  motorY->moveTo(0);
-  motorZ->moveTo(200);
-  
-  // Wait for completion
-  while (controller.isAnyRunning()) {
-    controller.update();
-    delay(10);
-  }
+  long first[3] = {800, 0, 200};
+  controller.moveToAll(first);
+  waitForMovement();
   
   // Second point
-  motorX->moveTo(0);
-  motorY->moveTo(800);
-  motorZ->moveTo(400);
-  
-  // Wait for completion
-  while (controller.isAnyRunning()) {
-    controller.update();
-    delay(10);
-  }
+  long second[3] = {0, 800, 400};
+  controller.moveToAll(second);
+  waitForMovement();
   
   // Third point
-  motorX->moveTo(-800);
-  motorY->moveTo(0);
-  motorZ->moveTo(600);
-  
-  // Wait for completion
-  while (controller.isAnyRunning()) {
-    controller.update();
-    delay(10);
-  }
+  long third[3] = {-800, 0, 600};
+  controller.moveToAll(third);
+  waitForMovement();
   
   // Fourth point
-  motorX->moveTo(0);
-  motorY->moveTo(-800);
-  motorZ->moveTo(800);
+  long fourth[3] = {0, -800, 800};
+  controller.moveToAll(fourth);
   
   // Note: We don't need to wait for completion of the last segment
   // since the main loop will detect when all motors have stopped
-}
+}
\ No newline at end of file
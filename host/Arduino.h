@@ -0,0 +1,105 @@
+#pragma once
+
+// Minimal Arduino API for building the library on a desktop compiler.
+// Time, pins and Serial are backed by the simulator in Simulator.hpp.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+
+#define F_CPU 16000000L
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define SERIAL_RX_BUFFER_SIZE 64
+
+#define DEC 10
+#define HEX 16
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Flash strings are ordinary strings on the host
+typedef char __FlashStringHelper;
+#define F(string) (reinterpret_cast<const __FlashStringHelper*>(string))
+#define PSTR(string) (string)
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define pgm_read_dword(address) (*(const uint32_t*)(address))
+#define pgm_read_ptr(address) (*(void* const*)(address))
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+
+#define noInterrupts()
+#define interrupts()
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define constrain(value, low, high) ((value) < (low) ? (low) : ((value) > (high) ? (high) : (value)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Every pin gets its own one-bit output register so direct port writes
+// (StepTimer) can be observed; see Simulator::sampleRegisters()
+#define digitalPinToPort(pin) (pin)
+#define digitalPinToBitMask(pin) (1)
+volatile uint8_t* portOutputRegister(uint8_t port);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+class Print {
+  public:
+    virtual ~Print() {}
+    
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* text);
+    
+    size_t print(const char* text);
+    size_t print(char c);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    
+    size_t println();
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int peek();
+    int availableForWrite();
+    void flush();
+    
+    virtual size_t write(uint8_t c);
+    using Print::write;
+    
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,25 @@
+#pragma once
+
+// Host stand-in for the AVR EEPROM library, backed by the simulator. Writes
+// keep the EEPROM busy for SIM_EEPROM_WRITE_US of virtual time, like the
+// hardware's 3.3 ms programming cycle.
+
+#include "Simulator.hpp"
+
+#define E2END (SIM_EEPROM_SIZE - 1)
+
+class EEPROMClass {
+  public:
+    uint8_t read(int address) { return Sim.readEeprom(address); }
+    void write(int address, uint8_t value) { Sim.writeEeprom(address, value); }
+    void update(int address, uint8_t value) {
+      if (read(address) != value) write(address, value);
+    }
+    uint16_t length() { return SIM_EEPROM_SIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+inline bool eeprom_is_ready() {
+  return Sim.isEepromReady();
+}
@@ -0,0 +1,340 @@
+#include "Simulator.hpp"
+#include "EEPROM.h"
+
+Simulator Sim;
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+Simulator::Simulator() {
+  _tx = stdout;
+  memset(_eeprom, 0xFF, sizeof(_eeprom));
+  _eepromWrites = 0;
+  reset();
+}
+
+void Simulator::reset() {
+  _micros = 0;
+  _callCost = 1;
+  _rxHead = 0;
+  _rxTail = 0;
+  _txBytes = 0;
+  _captureHead = 0;
+  _captureTail = 0;
+  _eepromReadyAt = 0;
+  _tracePin = 0xFF;
+  _traceStart = 0;
+  _traceCount = 0;
+  
+  for (uint8_t i = 0; i < SIM_PIN_COUNT; i++) {
+    _pinLevel[i] = LOW;
+    _pinMode[i] = INPUT;
+    _risingEdges[i] = 0;
+    _registers[i] = 0;
+    _sampled[i] = 0;
+  }
+}
+
+unsigned long Simulator::now() {
+  return _micros;
+}
+
+void Simulator::advance(unsigned long us) {
+  _micros += us;
+}
+
+void Simulator::setCallCost(unsigned long us) {
+  _callCost = us;
+}
+
+unsigned long Simulator::readClock() {
+  _micros += _callCost;
+  return _micros;
+}
+
+void Simulator::setPinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= SIM_PIN_COUNT) return;
+  
+  _pinMode[pin] = mode;
+  if (mode == INPUT_PULLUP) {
+    _pinLevel[pin] = HIGH;
+  }
+}
+
+void Simulator::writePin(uint8_t pin, uint8_t level) {
+  if (pin >= SIM_PIN_COUNT) return;
+  
+  if (level && !_pinLevel[pin]) {
+    _risingEdges[pin]++;
+    if (pin == _tracePin && _traceCount < SIM_TRACE_SIZE) {
+      _trace[_traceCount++] = _micros - _traceStart;
+    }
+  }
+  _pinLevel[pin] = level ? HIGH : LOW;
+}
+
+void Simulator::setInput(uint8_t pin, uint8_t level) {
+  if (pin >= SIM_PIN_COUNT) return;
+  _pinLevel[pin] = level ? HIGH : LOW;
+}
+
+uint8_t Simulator::readPin(uint8_t pin) {
+  return pin < SIM_PIN_COUNT ? _pinLevel[pin] : LOW;
+}
+
+uint8_t Simulator::getPinMode(uint8_t pin) {
+  return pin < SIM_PIN_COUNT ? _pinMode[pin] : INPUT;
+}
+
+unsigned long Simulator::getRisingEdges(uint8_t pin) {
+  return pin < SIM_PIN_COUNT ? _risingEdges[pin] : 0;
+}
+
+void Simulator::startTrace(uint8_t pin) {
+  _tracePin = pin;
+  _traceStart = _micros;
+  _traceCount = 0;
+}
+
+uint16_t Simulator::getTraceCount() {
+  return _traceCount;
+}
+
+unsigned long Simulator::getTraceTime(uint16_t index) {
+  return index < _traceCount ? _trace[index] : 0;
+}
+
+volatile uint8_t* Simulator::getRegister(uint8_t pin) {
+  return &_registers[pin < SIM_PIN_COUNT ? pin : 0];
+}
+
+void Simulator::sampleRegisters() {
+  for (uint8_t i = 0; i < SIM_PIN_COUNT; i++) {
+    uint8_t level = _registers[i] & 1;
+    if (level != _sampled[i]) {
+      _sampled[i] = level;
+      writePin(i, level);
+    }
+  }
+}
+
+void Simulator::sendLine(const char* line) {
+  sendBytes((const uint8_t*)line, strlen(line));
+  sendBytes((const uint8_t*)"\n", 1);
+}
+
+void Simulator::sendBytes(const uint8_t* data, uint16_t length) {
+  for (uint16_t i = 0; i < length; i++) {
+    uint16_t next = (_rxHead + 1) % SIM_RX_BUFFER_SIZE;
+    if (next == _rxTail) return;
+    
+    _rx[_rxHead] = data[i];
+    _rxHead = next;
+  }
+}
+
+int Simulator::available() {
+  return (_rxHead + SIM_RX_BUFFER_SIZE - _rxTail) % SIM_RX_BUFFER_SIZE;
+}
+
+int Simulator::read() {
+  if (_rxHead == _rxTail) return -1;
+  
+  uint8_t c = _rx[_rxTail];
+  _rxTail = (_rxTail + 1) % SIM_RX_BUFFER_SIZE;
+  return c;
+}
+
+int Simulator::peek() {
+  return _rxHead == _rxTail ? -1 : (uint8_t)_rx[_rxTail];
+}
+
+void Simulator::setOutput(FILE* file) {
+  _tx = file;
+}
+
+void Simulator::transmit(uint8_t c) {
+  _txBytes++;
+  
+  _capture[_captureHead] = c;
+  _captureHead = (_captureHead + 1) % SIM_CAPTURE_SIZE;
+  if (_captureHead == _captureTail) {
+    _captureTail = (_captureTail + 1) % SIM_CAPTURE_SIZE;
+  }
+  
+  if (_tx) {
+    fputc(c, _tx);
+  }
+}
+
+unsigned long Simulator::getTransmitted() {
+  return _txBytes;
+}
+
+int Simulator::readTransmitted() {
+  if (_captureHead == _captureTail) return -1;
+  
+  uint8_t c = _capture[_captureTail];
+  _captureTail = (_captureTail + 1) % SIM_CAPTURE_SIZE;
+  return c;
+}
+
+uint8_t Simulator::readEeprom(int address) {
+  return address >= 0 && address < SIM_EEPROM_SIZE ? _eeprom[address] : 0xFF;
+}
+
+// Like the hardware, a write waits for the previous one to finish
+void Simulator::writeEeprom(int address, uint8_t value) {
+  if (address < 0 || address >= SIM_EEPROM_SIZE) return;
+  
+  if ((long)(_eepromReadyAt - _micros) > 0) {
+    _micros = _eepromReadyAt;
+  }
+  _eeprom[address] = value;
+  _eepromReadyAt = _micros + SIM_EEPROM_WRITE_US;
+  _eepromWrites++;
+}
+
+bool Simulator::isEepromReady() {
+  return (long)(_eepromReadyAt - _micros) <= 0;
+}
+
+unsigned long Simulator::getEepromWrites() {
+  return _eepromWrites;
+}
+
+bool Simulator::loadEeprom(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  
+  size_t length = fread(_eeprom, 1, sizeof(_eeprom), file);
+  fclose(file);
+  return length == sizeof(_eeprom);
+}
+
+bool Simulator::saveEeprom(const char* path) {
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  
+  size_t length = fwrite(_eeprom, 1, sizeof(_eeprom), file);
+  fclose(file);
+  return length == sizeof(_eeprom);
+}
+
+// Arduino core functions
+
+unsigned long millis() {
+  return Sim.readClock() / 1000;
+}
+
+unsigned long micros() {
+  return Sim.readClock();
+}
+
+void delay(unsigned long ms) {
+  Sim.advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  Sim.advance(us);
+}
+
+volatile uint8_t* portOutputRegister(uint8_t port) {
+  return Sim.getRegister(port);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  Sim.setPinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  Sim.writePin(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  return Sim.readPin(pin);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t count = 0;
+  while (size--) {
+    count += write(*buffer++);
+  }
+  return count;
+}
+
+size_t Print::write(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t Print::print(const char* text) {
+  return write(text);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    return write(text);
+  }
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+  return write(text);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[40];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+void HardwareSerial::begin(unsigned long) {
+}
+
+int HardwareSerial::available() {
+  return Sim.available();
+}
+
+int HardwareSerial::read() {
+  return Sim.read();
+}
+
+int HardwareSerial::peek() {
+  return Sim.peek();
+}
+
+// The host link never backs up, but a realistic window keeps the output buffer honest
+int HardwareSerial::availableForWrite() {
+  return SIM_TX_WINDOW;
+}
+
+void HardwareSerial::flush() {
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  Sim.transmit(c);
+  return 1;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define SIM_PIN_COUNT 70
+#define SIM_RX_BUFFER_SIZE 1024
+#define SIM_TX_WINDOW 64
+#define SIM_CAPTURE_SIZE 4096
+#define SIM_TRACE_SIZE 8192
+#define SIM_EEPROM_SIZE 4096
+#define SIM_EEPROM_WRITE_US 3300
+
+// Deterministic virtual-time backend behind the host Arduino.h
+class Simulator {
+  private:
+    unsigned long _micros;
+    unsigned long _callCost;
+    
+    uint8_t _pinLevel[SIM_PIN_COUNT];
+    uint8_t _pinMode[SIM_PIN_COUNT];
+    unsigned long _risingEdges[SIM_PIN_COUNT];
+    volatile uint8_t _registers[SIM_PIN_COUNT];
+    uint8_t _sampled[SIM_PIN_COUNT];
+    
+    uint8_t _tracePin;
+    unsigned long _traceStart;
+    unsigned long _trace[SIM_TRACE_SIZE];
+    uint16_t _traceCount;
+    
+    char _rx[SIM_RX_BUFFER_SIZE];
+    uint16_t _rxHead;
+    uint16_t _rxTail;
+    
+    FILE* _tx;
+    unsigned long _txBytes;
+    uint8_t _capture[SIM_CAPTURE_SIZE];
+    uint16_t _captureHead;
+    uint16_t _captureTail;
+    
+    uint8_t _eeprom[SIM_EEPROM_SIZE];
+    unsigned long _eepromReadyAt;
+    unsigned long _eepromWrites;
+    
+  public:
+    Simulator();
+    
+    void reset();
+    
+    // Virtual time; every micros()/millis() call also costs _callCost microseconds
+    // so busy loops make progress
+    unsigned long now();
+    void advance(unsigned long us);
+    void setCallCost(unsigned long us);
+    unsigned long readClock();
+    
+    void setPinMode(uint8_t pin, uint8_t mode);
+    void writePin(uint8_t pin, uint8_t level);
+    void setInput(uint8_t pin, uint8_t level);
+    uint8_t readPin(uint8_t pin);
+    uint8_t getPinMode(uint8_t pin);
+    unsigned long getRisingEdges(uint8_t pin);
+    
+    // Records the time of each rising edge on one pin since startTrace(),
+    // up to SIM_TRACE_SIZE
+    void startTrace(uint8_t pin);
+    uint16_t getTraceCount();
+    unsigned long getTraceTime(uint16_t index);
+    
+    // Register writes only reach the pins when sampled, like a logic analyser
+    volatile uint8_t* getRegister(uint8_t pin);
+    void sampleRegisters();
+    
+    void sendLine(const char* line);
+    void sendBytes(const uint8_t* data, uint16_t length);
+    int available();
+    int read();
+    int peek();
+    
+    void setOutput(FILE* file);
+    void transmit(uint8_t c);
+    unsigned long getTransmitted();
+    
+    // Everything transmitted is also kept, oldest dropped first, for scripts
+    // that decode the replies
+    int readTransmitted();
+    
+    // EEPROM contents survive reset(); load/save keep them across runs
+    uint8_t readEeprom(int address);
+    void writeEeprom(int address, uint8_t value);
+    bool isEepromReady();
+    unsigned long getEepromWrites();
+    bool loadEeprom(const char* path);
+    bool saveEeprom(const char* path);
+};
+
+extern Simulator Sim;
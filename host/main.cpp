@@ -0,0 +1,584 @@
+// Host simulator entry point: runs the sketch in virtual time and drives it
+// from a script of serial commands and checks.
+//
+//   stepper_sim [-q] [-l loop_us] [-e eeprom_file] [script]
+//
+// HOST_SKETCH selects the sketch to build in; it defaults to the main sketch.
+// With -e the EEPROM image is loaded before setup() and written back at exit,
+// so a second run sees what the first one saved.
+//
+// Script lines are sent to the sketch as serial input, except for:
+//   # comment
+//   !wait <ms>              run the sketch for <ms> of virtual time
+//   !idle [timeout_ms]      run until no motor is moving (default 60 s)
+//   !input <pin> <level>    drive an input pin
+//   !endstop <pin> <motor> <pos>  pull <pin> low while the motor is at or below <pos>
+//   !expect <motor> <pos>   fail unless the motor is at <pos> steps
+//   !range <motor> <min> <max>  fail unless the motor is within [min, max] now
+//   !pulses <pin> <count>   fail unless <count> step pulses were seen on <pin>
+//   !steps <motor> <pin>    fail unless the stats step count for the motor
+//                           matches the pulses seen on its step pin
+//   !extent <motor> <min> <max>  fail if the motor left [min, max] since the last !extent
+//   !trace <pin>            start recording the time of each pulse on <pin>
+//   !keep                   keep the current trace for a later !match
+//   !shape <accel> <jerk>   fail if the traced motion peaks above <accel> steps/s^2
+//                           or, unless 0, <jerk> steps/s^3 (25% allowed for
+//                           step quantisation)
+//   !match <steps>          fail unless the trace has as many pulses as the kept
+//                           one and, timed from each !trace, never leads or
+//                           lags it by more than <steps>
+//   !profiles <speed> <accel> <steps> <us>  fail unless FixedProfile reaches
+//                           every step of the move within <us> of MotionProfile,
+//                           both updated every SIM_PROFILE_PERIOD_US
+//   !time                   print the current virtual time
+//   !frame <opcode> [arg ...]  send a binary frame with a valid CRC; args are
+//                           bytes, =<n> a little-endian int32 or ~<x> a float
+//   !raw <byte> ...         send bytes exactly as given (garbage, bad CRCs)
+//   !reply <opcode> <status> [byte ...]  fail unless the next binary frame
+//                           from the sketch is a valid <opcode> reply with
+//                           <status>, followed by the given bytes if any;
+//                           telemetry frames in between are skipped
+//   !telemetry <motor> <pos>  fail unless the newest telemetry frame sent so far
+//                           decodes and shows the motor at <pos>; replies
+//                           still waiting to be checked are discarded
+
+#include <limits.h>
+#include "Simulator.hpp"
+
+void setup();
+void loop();
+void processSerialInput();
+
+#ifndef HOST_SKETCH
+#define HOST_SKETCH "../stepper_control.ino"
+#endif
+
+#include HOST_SKETCH
+
+#define SIM_DEFAULT_IDLE_TIMEOUT 60000UL
+#define SIM_TICK_MICROS (1000000UL / STEP_TIMER_FREQUENCY)
+
+#define SIM_MAX_ENDSTOPS 4
+
+// !shape differentiates the traced position over this spacing, skipping
+// stretches with fewer than SIM_SHAPE_MIN_PULSES pulses per spacing, and
+// allows this much headroom over the limits for the quantisation left over
+#define SIM_SHAPE_WINDOW_US 20000L
+#define SIM_SHAPE_MIN_PULSES 4
+#define SIM_SHAPE_TOLERANCE 1.25
+
+// !profiles updates both profiles at this period, as the benchmark does
+#define SIM_PROFILE_PERIOD_US 100UL
+#define SIM_PROFILE_TIMEOUT_US 60000000UL
+
+struct Endstop {
+  uint8_t pin;
+  uint8_t motor;
+  long position;
+};
+
+static unsigned long loopCost = 10;
+static BinaryProtocol replyDecoder;
+static unsigned long lastTick = 0;
+static Endstop endstops[SIM_MAX_ENDSTOPS];
+static uint8_t endstopCount = 0;
+static long lowest[MAX_MOTORS];
+static long highest[MAX_MOTORS];
+static unsigned long keptTrace[SIM_TRACE_SIZE];
+static uint16_t keptCount = 0;
+
+static void resetExtent(uint8_t motor) {
+  lowest[motor] = highest[motor] = controller.getMotor(motor)->getCurrentPosition();
+}
+
+static void trackExtents() {
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    long position = controller.getMotor(i)->getCurrentPosition();
+    if (position < lowest[i]) lowest[i] = position;
+    if (position > highest[i]) highest[i] = position;
+  }
+}
+
+static void updateEndstops() {
+  for (uint8_t i = 0; i < endstopCount; i++) {
+    Motor* motor = controller.getMotor(endstops[i].motor);
+    bool pressed = motor && motor->getCurrentPosition() <= endstops[i].position;
+    Sim.setInput(endstops[i].pin, pressed ? LOW : HIGH);
+  }
+}
+
+static void runOnce() {
+  updateEndstops();
+  loop();
+  Sim.advance(loopCost);
+  
+#if STEP_TIMER_ENABLED
+  while (Sim.now() - lastTick >= SIM_TICK_MICROS) {
+    stepTimer.advance(1);
+    Sim.sampleRegisters();
+    lastTick += SIM_TICK_MICROS;
+  }
+#endif
+  
+  trackExtents();
+}
+
+static void runFor(unsigned long ms) {
+  unsigned long start = Sim.now();
+  while (Sim.now() - start < ms * 1000UL) {
+    runOnce();
+  }
+}
+
+static bool anyMotorRunning() {
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    if (controller.getMotor(i)->isRunning()) return true;
+  }
+  return false;
+}
+
+static bool runUntilIdle(unsigned long timeoutMs) {
+  unsigned long start = Sim.now();
+  
+  // Let pending input reach the sketch and its replies drain before looking at the motors
+  runOnce();
+  while (anyMotorRunning() || controller.isAnyRunning() || Serial.available() > 0 || Output.getPending() > 0) {
+    if (Sim.now() - start >= timeoutMs * 1000UL) return false;
+    runOnce();
+  }
+  return true;
+}
+
+// Parses the arguments of !frame and !raw into bytes
+static int parseBytes(const char* text, uint8_t* data, int capacity) {
+  char buffer[256];
+  strncpy(buffer, text, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+  
+  int length = 0;
+  for (char* token = strtok(buffer, " "); token; token = strtok(NULL, " ")) {
+    int size = (token[0] == '=' || token[0] == '~') ? 4 : 1;
+    if (length + size > capacity) return -1;
+    
+    if (token[0] == '=') {
+      BinaryProtocol::writeInt32(data + length, strtol(token + 1, NULL, 0));
+    }
+    else if (token[0] == '~') {
+      float value = strtof(token + 1, NULL);
+      int32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      BinaryProtocol::writeInt32(data + length, bits);
+    }
+    else {
+      data[length] = strtoul(token, NULL, 0);
+    }
+    length += size;
+  }
+  return length;
+}
+
+static bool sendBinary(const char* text, bool framed, unsigned int lineNumber) {
+  uint8_t data[BINARY_MAX_PAYLOAD + 16];
+  int length = parseBytes(text, data, sizeof(data));
+  
+  if (length < (framed ? 1 : 0)) {
+    fprintf(stderr, "line %u: bad bytes: %s\n", lineNumber, text);
+    return false;
+  }
+  
+  if (framed) {
+    uint8_t frame[sizeof(data) + 4];
+    uint8_t size = BinaryProtocol::encode(frame, data[0], data + 1, length - 1);
+    Sim.sendBytes(frame, size);
+  }
+  else {
+    Sim.sendBytes(data, length);
+  }
+  runOnce();
+  return true;
+}
+
+// Lets the sketch read everything sent so far and push out its replies
+static void drainOutput() {
+  runOnce();
+  while (Serial.available() > 0 || Output.getPending() > 0) {
+    runOnce();
+  }
+}
+
+static bool expectReply(const char* text, unsigned int lineNumber) {
+  uint8_t expected[BINARY_MAX_PAYLOAD + 1];
+  int length = parseBytes(text, expected, sizeof(expected));
+  if (length < 2) {
+    fprintf(stderr, "line %u: bad reply: %s\n", lineNumber, text);
+    return false;
+  }
+  
+  long opcode = expected[0];
+  long status = expected[1];
+  drainOutput();
+  
+  for (int c = Sim.readTransmitted(); c >= 0; c = Sim.readTransmitted()) {
+    if (!replyDecoder.feed(c)) continue;
+    
+    if (replyDecoder.hasCrcError()) {
+      fprintf(stderr, "line %u: reply with a bad CRC\n", lineNumber);
+      return false;
+    }
+    if (replyDecoder.getOpcode() == OP_TELEMETRY) continue;
+    
+    const uint8_t* payload = replyDecoder.getPayload();
+    long got = replyDecoder.getLength() > 0 ? payload[0] : -1;
+    if (replyDecoder.getOpcode() == opcode && got == status) {
+      for (int i = 2; i < length; i++) {
+        if (i - 1 >= replyDecoder.getLength() || payload[i - 1] != expected[i]) {
+          fprintf(stderr, "line %u: reply byte %d is %d, expected %d\n", lineNumber, i - 1,
+                  i - 1 < replyDecoder.getLength() ? payload[i - 1] : -1, expected[i]);
+          return false;
+        }
+      }
+      return true;
+    }
+    
+    fprintf(stderr, "line %u: reply 0x%02X status %ld, expected 0x%02lX status %ld\n", lineNumber,
+            replyDecoder.getOpcode(), got, opcode, status);
+    return false;
+  }
+  
+  fprintf(stderr, "line %u: no reply, expected 0x%02lX\n", lineNumber, opcode);
+  return false;
+}
+
+static bool expectTelemetry(long motor, long position, unsigned int lineNumber) {
+  drainOutput();
+  
+  bool seen = false;
+  long reported = 0;
+  for (int c = Sim.readTransmitted(); c >= 0; c = Sim.readTransmitted()) {
+    if (!replyDecoder.feed(c) || replyDecoder.getOpcode() != OP_TELEMETRY) continue;
+    
+    const uint8_t* payload = replyDecoder.getPayload();
+    uint8_t count = controller.getMotorCount();
+    if (replyDecoder.hasCrcError() || replyDecoder.getLength() != TELEMETRY_HEADER_SIZE + count * TELEMETRY_MOTOR_SIZE || payload[5] != count) {
+      fprintf(stderr, "line %u: malformed telemetry frame\n", lineNumber);
+      return false;
+    }
+    seen = true;
+    reported = BinaryProtocol::readInt32(payload + TELEMETRY_HEADER_SIZE + motor * TELEMETRY_MOTOR_SIZE);
+  }
+  
+  if (!seen) {
+    fprintf(stderr, "line %u: no telemetry frame\n", lineNumber);
+    return false;
+  }
+  if (reported == position) return true;
+  
+  fprintf(stderr, "line %u: telemetry shows motor %ld at %ld, expected %ld\n", lineNumber, motor, reported, position);
+  return false;
+}
+
+// Steps taken by time t, interpolated between the traced pulses
+static double tracePosition(double t) {
+  uint16_t count = Sim.getTraceCount();
+  if (count == 0 || t < Sim.getTraceTime(0)) return 0.0;
+  if (t >= Sim.getTraceTime(count - 1)) return count;
+  
+  uint16_t low = 0;
+  uint16_t high = count - 1;
+  while (high - low > 1) {
+    uint16_t middle = (low + high) / 2;
+    if (Sim.getTraceTime(middle) <= t) low = middle;
+    else high = middle;
+  }
+  
+  double start = Sim.getTraceTime(low);
+  return low + 1 + (t - start) / (Sim.getTraceTime(high) - start);
+}
+
+// Central differences of the traced position give the acceleration and jerk
+static bool expectShape(long accel, long jerk, unsigned int lineNumber) {
+  uint16_t count = Sim.getTraceCount();
+  if (count < 2) {
+    fprintf(stderr, "line %u: trace has %u pulses\n", lineNumber, count);
+    return false;
+  }
+  
+  double w = SIM_SHAPE_WINDOW_US * 1.0e-6;
+  double peakAccel = 0.0;
+  double peakJerk = 0.0;
+  
+  for (long t = Sim.getTraceTime(0) + 2 * SIM_SHAPE_WINDOW_US; t + 2 * SIM_SHAPE_WINDOW_US <= (long)Sim.getTraceTime(count - 1); t += 1000) {
+    double p[5];
+    bool resolved = true;
+    for (int k = 0; k < 5; k++) {
+      p[k] = tracePosition(t + (k - 2) * SIM_SHAPE_WINDOW_US);
+      if (k > 0 && p[k] - p[k - 1] < SIM_SHAPE_MIN_PULSES) resolved = false;
+    }
+    if (!resolved) continue;
+    
+    peakAccel = max(peakAccel, fabs(p[1] - 2.0 * p[2] + p[3]) / (w * w));
+    peakJerk = max(peakJerk, fabs(p[4] - 2.0 * p[3] + 2.0 * p[1] - p[0]) / (2.0 * w * w * w));
+  }
+  
+  bool inside = peakAccel <= accel * SIM_SHAPE_TOLERANCE && (jerk == 0 || peakJerk <= jerk * SIM_SHAPE_TOLERANCE);
+  if (!inside) {
+    fprintf(stderr, "line %u: trace peaks at %.0f steps/s^2 and %.0f steps/s^3, limits %ld and %ld\n",
+            lineNumber, peakAccel, peakJerk, accel, jerk);
+  }
+  return inside;
+}
+
+// Both traces are timed from their !trace, and pulses are counted rather
+// than interpolated
+static bool matchTrace(long tolerance, unsigned int lineNumber) {
+  uint16_t count = Sim.getTraceCount();
+  if (count != keptCount) {
+    fprintf(stderr, "line %u: trace has %u pulses, kept trace has %u\n", lineNumber, count, keptCount);
+    return false;
+  }
+  
+  uint16_t i = 0;
+  uint16_t j = 0;
+  while (i < count || j < keptCount) {
+    unsigned long next = i < count ? Sim.getTraceTime(i) : ULONG_MAX;
+    if (j < keptCount && keptTrace[j] < next) next = keptTrace[j];
+    
+    while (i < count && Sim.getTraceTime(i) == next) i++;
+    while (j < keptCount && keptTrace[j] == next) j++;
+    
+    if (abs((int)i - (int)j) > tolerance) {
+      fprintf(stderr, "line %u: %lu us in, the trace is at step %u and the kept one at %u\n", lineNumber, next, i, j);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs the same move through MotionProfile and FixedProfile and compares the
+// time at which each one reaches every step
+static bool compareProfiles(long speed, long accel, long distance, long tolerance, unsigned int lineNumber) {
+  static unsigned long floatSteps[SIM_TRACE_SIZE];
+  if (distance <= 0 || distance > SIM_TRACE_SIZE) {
+    fprintf(stderr, "line %u: distance must be 1 to %d steps\n", lineNumber, SIM_TRACE_SIZE);
+    return false;
+  }
+  
+  MotionProfile floatProfile;
+  FixedProfile fixedProfile;
+  floatProfile.setMaxSpeed(speed);
+  floatProfile.setAcceleration(accel);
+  fixedProfile.setMaxSpeed(speed);
+  fixedProfile.setAcceleration(accel);
+  
+  double position = 0.0;
+  long reached = 0;
+  unsigned long time = 0;
+  while (reached < distance && time < SIM_PROFILE_TIMEOUT_US) {
+    position += floatProfile.update(distance - reached, SIM_PROFILE_PERIOD_US * 1.0e-6) * (SIM_PROFILE_PERIOD_US * 1.0e-6);
+    time += SIM_PROFILE_PERIOD_US;
+    while (reached < distance && position >= reached + 1) {
+      floatSteps[reached++] = time;
+    }
+  }
+  
+  // Q16.16 steps, integrated the way the fixed-point timer path does
+  int64_t fixedPosition = 0;
+  long fixedReached = 0;
+  long worst = 0;
+  time = 0;
+  while (fixedReached < reached && time < SIM_PROFILE_TIMEOUT_US) {
+    fixedPosition += ((int64_t)fixedProfile.updateFixed(distance - fixedReached, SIM_PROFILE_PERIOD_US) * SIM_PROFILE_PERIOD_US) / 1000000L;
+    time += SIM_PROFILE_PERIOD_US;
+    while (fixedReached < reached && (fixedPosition >> 16) >= fixedReached + 1) {
+      long offset = (long)time - (long)floatSteps[fixedReached++];
+      if (labs(offset) > labs(worst)) worst = offset;
+    }
+  }
+  
+  if (reached < distance || fixedReached < distance) {
+    fprintf(stderr, "line %u: float profile reached step %ld, fixed profile step %ld, of %ld\n", lineNumber, reached, fixedReached, distance);
+    return false;
+  }
+  if (labs(worst) <= tolerance) return true;
+  
+  fprintf(stderr, "line %u: fixed profile is up to %ld us off the float profile\n", lineNumber, worst);
+  return false;
+}
+
+static bool runDirective(const char* line, unsigned int lineNumber) {
+  char name[16];
+  long a = 0;
+  long b = 0;
+  long c = 0;
+  long d = 0;
+  int fields = sscanf(line, "!%15s %li %li %li %li", name, &a, &b, &c, &d);
+  
+  if (fields >= 1 && (strcmp(name, "frame") == 0 || strcmp(name, "raw") == 0)) {
+    return sendBinary(line + 1 + strlen(name), name[0] == 'f', lineNumber);
+  }
+  
+  if (fields >= 3 && strcmp(name, "reply") == 0) {
+    return expectReply(line + 1 + strlen(name), lineNumber);
+  }
+  
+  if (fields == 3 && strcmp(name, "telemetry") == 0 && a >= 0 && a < controller.getMotorCount()) {
+    return expectTelemetry(a, b, lineNumber);
+  }
+  
+  if (fields >= 2 && strcmp(name, "wait") == 0) {
+    runFor(a);
+    return true;
+  }
+  
+  if (fields >= 1 && strcmp(name, "idle") == 0) {
+    if (runUntilIdle(fields >= 2 ? a : SIM_DEFAULT_IDLE_TIMEOUT)) return true;
+    
+    fprintf(stderr, "line %u: motors still moving after timeout\n", lineNumber);
+    return false;
+  }
+  
+  if (fields == 3 && strcmp(name, "input") == 0) {
+    Sim.setInput(a, b);
+    return true;
+  }
+  
+  if (fields == 4 && strcmp(name, "endstop") == 0 && endstopCount < SIM_MAX_ENDSTOPS) {
+    endstops[endstopCount].pin = a;
+    endstops[endstopCount].motor = b;
+    endstops[endstopCount].position = c;
+    endstopCount++;
+    updateEndstops();
+    return true;
+  }
+  
+  if (fields == 3 && strcmp(name, "expect") == 0) {
+    Motor* motor = controller.getMotor(a);
+    if (motor && motor->getCurrentPosition() == b) return true;
+    
+    fprintf(stderr, "line %u: motor %ld at %ld, expected %ld\n", lineNumber, a,
+            motor ? motor->getCurrentPosition() : 0L, b);
+    return false;
+  }
+  
+  if (fields == 3 && strcmp(name, "steps") == 0 && a >= 0 && a < controller.getMotorCount()) {
+    unsigned long counted = controller.getStats()->getSteps(a);
+    if (counted == Sim.getRisingEdges(b)) return true;
+    
+    fprintf(stderr, "line %u: motor %ld counted %lu steps, pin %ld saw %lu pulses\n", lineNumber, a, counted, b, Sim.getRisingEdges(b));
+    return false;
+  }
+  
+  if (fields == 4 && strcmp(name, "range") == 0 && a >= 0 && a < controller.getMotorCount()) {
+    long position = controller.getMotor(a)->getCurrentPosition();
+    if (position >= b && position <= c) return true;
+    
+    fprintf(stderr, "line %u: motor %ld at %ld, expected %ld to %ld\n", lineNumber, a, position, b, c);
+    return false;
+  }
+  
+  if (fields == 4 && strcmp(name, "extent") == 0 && a >= 0 && a < controller.getMotorCount()) {
+    bool inside = lowest[a] >= b && highest[a] <= c;
+    if (!inside) {
+      fprintf(stderr, "line %u: motor %ld ranged %ld to %ld, expected %ld to %ld\n", lineNumber, a, lowest[a], highest[a], b, c);
+    }
+    resetExtent(a);
+    return inside;
+  }
+  
+  if (fields == 3 && strcmp(name, "pulses") == 0) {
+    unsigned long pulses = Sim.getRisingEdges(a);
+    if (pulses == (unsigned long)b) return true;
+    
+    fprintf(stderr, "line %u: pin %ld saw %lu pulses, expected %ld\n", lineNumber, a, pulses, b);
+    return false;
+  }
+  
+  if (fields == 2 && strcmp(name, "trace") == 0) {
+    Sim.startTrace(a);
+    return true;
+  }
+  
+  if (fields >= 1 && strcmp(name, "keep") == 0) {
+    keptCount = Sim.getTraceCount();
+    for (uint16_t i = 0; i < keptCount; i++) {
+      keptTrace[i] = Sim.getTraceTime(i);
+    }
+    return true;
+  }
+  
+  if (fields == 3 && strcmp(name, "shape") == 0) {
+    return expectShape(a, b, lineNumber);
+  }
+  
+  if (fields == 2 && strcmp(name, "match") == 0) {
+    return matchTrace(a, lineNumber);
+  }
+  
+  if (fields == 5 && strcmp(name, "profiles") == 0) {
+    return compareProfiles(a, b, c, d, lineNumber);
+  }
+  
+  if (fields >= 1 && strcmp(name, "time") == 0) {
+    printf("# t=%lu us\n", Sim.now());
+    return true;
+  }
+  
+  fprintf(stderr, "line %u: bad directive: %s\n", lineNumber, line);
+  return false;
+}
+
+int main(int argc, char** argv) {
+  FILE* script = stdin;
+  const char* eepromFile = NULL;
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-q") == 0) {
+      Sim.setOutput(NULL);
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      loopCost = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      eepromFile = argv[++i];
+      Sim.loadEeprom(eepromFile);
+    } else {
+      script = fopen(argv[i], "r");
+      if (!script) {
+        fprintf(stderr, "cannot open %s\n", argv[i]);
+        return 2;
+      }
+    }
+  }
+  
+  setup();
+  lastTick = Sim.now();
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    resetExtent(i);
+  }
+  
+  char line[256];
+  unsigned int lineNumber = 0;
+  
+  while (fgets(line, sizeof(line), script)) {
+    lineNumber++;
+    line[strcspn(line, "\r\n")] = '\0';
+    
+    if (line[0] == '\0' || line[0] == '#') continue;
+    
+    if (line[0] == '!') {
+      if (!runDirective(line, lineNumber)) return 1;
+      continue;
+    }
+    
+    Sim.sendLine(line);
+    runOnce();
+  }
+  
+  // Drain whatever the last command started
+  runUntilIdle(SIM_DEFAULT_IDLE_TIMEOUT);
+  
+  if (eepromFile && !Sim.saveEeprom(eepromFile)) {
+    fprintf(stderr, "cannot write %s\n", eepromFile);
+    return 2;
+  }
+  return 0;
+}
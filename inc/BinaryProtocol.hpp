@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include "StepperConfig.hpp"
+
+enum BinaryOpcode {
+  OP_PING = 0x01,
+  OP_MOVE_TO = 0x02,
+  OP_MOVE_TO_ALL = 0x03,
+  OP_QUEUE_MOVE = 0x04,
+  OP_SET_SPEED = 0x05,
+  OP_SET_ACCEL = 0x06,
+  OP_STOP = 0x07,
+  OP_STOP_ALL = 0x08,
+  OP_EMERGENCY_STOP = 0x09,
+  OP_RESUME = 0x0A,
+  OP_STATUS = 0x0B,
+  OP_ENABLE = 0x0C,
+  OP_POSE = 0x0D,
+  OP_POSE_QUATERNION = 0x0E,
+  OP_SUBSCRIBE = 0x0F,
+  OP_TELEMETRY = 0x10,
+  OP_WAYPOINT = 0x11,
+  OP_JOG = 0x12,
+  OP_TEXT_MODE = 0x7F,
+  OP_REPLY = 0x80,
+  OP_CRC_ERROR = 0xFF
+};
+
+enum BinaryStatus {
+  STATUS_OK = 0,
+  STATUS_INVALID_ARGUMENT = 1,
+  STATUS_UNKNOWN_OPCODE = 2,
+  STATUS_BUSY = 3,
+  STATUS_CRC_ERROR = 4,
+  STATUS_LIMITED = 5
+};
+
+class BinaryProtocol {
+  private:
+    enum DecoderState {
+      WAIT_SYNC,
+      WAIT_LENGTH,
+      WAIT_OPCODE,
+      WAIT_PAYLOAD,
+      WAIT_CRC_LOW,
+      WAIT_CRC_HIGH
+    };
+    
+    DecoderState _state;
+    uint8_t _length;
+    uint8_t _opcode;
+    uint8_t _received;
+    uint16_t _crc;
+    uint16_t _frameCrc;
+    uint16_t _crcErrors;
+    uint8_t _payload[BINARY_MAX_PAYLOAD];
+    
+  public:
+    BinaryProtocol();
+    
+    void reset();
+    bool feed(uint8_t data);
+    bool hasCrcError();
+    
+    uint8_t getOpcode();
+    uint8_t getLength();
+    const uint8_t* getPayload();
+    uint16_t getCrcErrors();
+    
+    static uint16_t crc16(uint16_t crc, uint8_t data);
+    static uint8_t encode(uint8_t* frame, uint8_t opcode, const uint8_t* payload, uint8_t length);
+    static void send(Print& out, uint8_t opcode, const uint8_t* payload, uint8_t length);
+    
+    static int16_t readInt16(const uint8_t* data);
+    static int32_t readInt32(const uint8_t* data);
+    static float readFloat(const uint8_t* data);
+    static void writeInt32(uint8_t* data, int32_t value);
+};
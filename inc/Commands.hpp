@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include "StepperConfig.hpp"
+
+class StepperController;
+
+struct CommandArgs {
+  uint8_t motor;
+  long value;
+  float number;
+  uint8_t numberCount;
+  float numbers[COMMAND_MAX_NUMBERS];
+  uint8_t count;
+  
+  // Per-motor lists: 'A' fills values, 'F' fills reals and 'P' fills both
+  // with position/velocity pairs
+  long values[MAX_MOTORS];
+  float reals[MAX_MOTORS];
+};
+
+typedef bool (*CommandHandler)(StepperController& controller, CommandArgs& args);
+
+struct CommandEntry {
+  char name[COMMAND_NAME_SIZE];
+  char schema[COMMAND_SCHEMA_SIZE];
+  char help[COMMAND_HELP_SIZE];
+  CommandHandler handler;
+};
+
+struct UserCommand {
+  const char* name;
+  const char* schema;
+  const char* help;
+  CommandHandler handler;
+};
+
+int8_t findCommand(const char* name);
+void readCommandSchema(uint8_t index, char* schema);
+CommandHandler readCommandHandler(uint8_t index);
+bool isMailboxBarrier(uint8_t index);
+void printCommandHelp(Print& out);
+void printCommandUsage(Print& out, uint8_t index);
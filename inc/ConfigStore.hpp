@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Motor.hpp"
+#include "StepperConfig.hpp"
+
+// Per-motor flag bits in a saved configuration
+#define CONFIG_INVERTED 0x01
+#define CONFIG_LIMITS 0x02
+#define CONFIG_CALIBRATED 0x04
+
+struct MotorConfig {
+  int32_t homePosition;
+  int32_t minPosition;
+  int32_t maxPosition;
+  float stepsPerUnit;
+  float maxSpeed;
+  float acceleration;
+  float jerk;
+  uint8_t flags;
+};
+
+// The CRC comes last so a write cut short by a reset never validates
+struct ConfigRecord {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t motorCount;
+  uint16_t sequence;
+  MotorConfig motors[MAX_MOTORS];
+  uint16_t crc;
+};
+
+// Keeps calibration and motion settings in EEPROM. Records rotate through
+// CONFIG_SLOTS slots and the newest valid one wins on load, so each save wears
+// a different slot and an interrupted save leaves the previous one intact.
+//
+// Changes are only written once the settings have stayed the same for
+// CONFIG_SAVE_DELAY_MS, and then one byte per update() while the EEPROM is
+// ready, so saving never blocks stepping. Saving starts once load() has run.
+class ConfigStore {
+  private:
+    Motor* _motors;
+    uint8_t _motorCount;
+    bool _enabled;
+    bool _saveRequested;
+    bool _writing;
+    uint8_t _slot;
+    uint16_t _sequence;
+    uint16_t _saves;
+    uint16_t _savedHash;
+    uint16_t _pendingHash;
+    unsigned long _changedAt;
+    unsigned long _lastCheck;
+    uint16_t _writeIndex;
+    ConfigRecord _record;
+    
+    uint16_t capture();
+    void apply();
+    bool readSlot(uint8_t slot);
+    void writeNext();
+    
+  public:
+    ConfigStore();
+    
+    void begin(Motor* motors, uint8_t motorCount);
+    
+    // Applies the newest valid record; false leaves the current settings alone
+    bool load();
+    void save();
+    void update(bool idle);
+    
+    bool isPending();
+    uint8_t getSlot();
+    uint16_t getSequence();
+    uint16_t getSaves();
+    void print(Print& out);
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Motor.hpp"
+#include "MotionProfile.hpp"
+#include "StepTimer.hpp"
+#include "StepperConfig.hpp"
+
+class CoordinatedMove {
+  private:
+    Motor* _motors;
+    uint8_t _axisCount;
+    uint8_t _axisMask;
+    bool _active;
+    bool _timerDriven;
+    long _delta[MAX_MOTORS];
+    long _error[MAX_MOTORS];
+    long _totalSteps;
+    long _completedSteps;
+    long _stopAt;
+    float _pathRatio;
+    fixed_t _exitSpeed;
+    bool _retargetPending;
+    fixed_t _retargetSpeed;
+    long _retarget[MAX_MOTORS];
+    StepProfile _profile;
+    unsigned long _lastStepTime;
+    fixed_t _stepSpeed;
+    uint32_t _stepInterval;
+    unsigned long _lastUpdateTime;
+    
+    void stepAxes();
+    void release();
+    float junctionSpeed(const long targets[]);
+    
+  public:
+    CoordinatedMove();
+    
+    bool start(Motor* motors, uint8_t axisCount, const long targets[], float entrySpeed = 0.0, float exitSpeed = 0.0);
+    
+    // Blends into new targets from the current position and speed; the turn is
+    // taken at the planner's junction speed, braking along the old line first
+    bool retarget(Motor* motors, uint8_t axisCount, const long targets[]);
+    void setExitSpeed(float speed);
+    void run();
+    void stop();
+    
+    bool isActive();
+    bool isRetargeting();
+    float getSpeed();
+    float getPathSpeed();
+    long getTotalSteps();
+    long getRemainingSteps();
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <Arduino.h>
+
+#ifdef __AVR__
+
+// Port letter and bit of every Arduino Mega 2560 pin, resolvable at compile time
+struct MegaPinMap {
+  static constexpr char port(uint8_t pin) {
+    return pin <= 3 ? 'E' : pin == 4 ? 'G' : pin == 5 ? 'E' :
+           pin <= 9 ? 'H' : pin <= 13 ? 'B' : pin <= 15 ? 'J' : pin <= 17 ? 'H' :
+           pin <= 21 ? 'D' : pin <= 29 ? 'A' : pin <= 37 ? 'C' : pin == 38 ? 'D' :
+           pin <= 41 ? 'G' : pin <= 49 ? 'L' : pin <= 53 ? 'B' : pin <= 61 ? 'F' :
+           pin <= 69 ? 'K' : 0;
+  }
+  
+  static constexpr uint8_t bit(uint8_t pin) {
+    return pin <= 1 ? pin : pin <= 3 ? pin + 2 : pin == 4 ? 5 : pin == 5 ? 3 :
+           pin <= 9 ? pin - 3 : pin <= 13 ? pin - 6 : pin <= 15 ? 15 - pin : pin <= 17 ? 17 - pin :
+           pin <= 21 ? 21 - pin : pin <= 29 ? pin - 22 : pin <= 37 ? 37 - pin : pin == 38 ? 7 :
+           pin <= 41 ? 41 - pin : pin <= 49 ? 49 - pin : pin <= 53 ? 53 - pin : pin <= 61 ? pin - 54 :
+           pin <= 69 ? pin - 62 : 0;
+  }
+};
+
+// Unmapped pins (such as 0xFF for "no pin") land on a scratch byte
+template <char PORT_LETTER> struct FastPort {
+  static volatile uint8_t& out() { static volatile uint8_t scratch; return scratch; }
+  static volatile uint8_t& mode() { return out(); }
+  static volatile uint8_t& in() { return out(); }
+  static const bool EXTENDED = false;
+};
+
+#define FAST_PORT(letter, port, ddr, pins, extended) \
+  template <> struct FastPort<letter> { \
+    static volatile uint8_t& out() { return port; } \
+    static volatile uint8_t& mode() { return ddr; } \
+    static volatile uint8_t& in() { return pins; } \
+    static const bool EXTENDED = extended; \
+  };
+
+FAST_PORT('A', PORTA, DDRA, PINA, false)
+FAST_PORT('B', PORTB, DDRB, PINB, false)
+FAST_PORT('C', PORTC, DDRC, PINC, false)
+FAST_PORT('D', PORTD, DDRD, PIND, false)
+FAST_PORT('E', PORTE, DDRE, PINE, false)
+FAST_PORT('F', PORTF, DDRF, PINF, false)
+FAST_PORT('G', PORTG, DDRG, PING, false)
+FAST_PORT('H', PORTH, DDRH, PINH, true)
+FAST_PORT('J', PORTJ, DDRJ, PINJ, true)
+FAST_PORT('K', PORTK, DDRK, PINK, true)
+FAST_PORT('L', PORTL, DDRL, PINL, true)
+
+#undef FAST_PORT
+
+// Ports A-G compile to single sbi/cbi instructions; H-L are outside the
+// bit-addressable range, so their read-modify-write is kept atomic
+template <uint8_t PIN>
+class FastPin {
+  private:
+    typedef FastPort<MegaPinMap::port(PIN)> Port;
+    static const uint8_t MASK = 1 << MegaPinMap::bit(PIN);
+    
+  public:
+    static inline void output() __attribute__((always_inline)) {
+      uint8_t oldSREG = SREG;
+      cli();
+      Port::mode() |= MASK;
+      SREG = oldSREG;
+    }
+    
+    static inline void high() __attribute__((always_inline)) {
+      if (Port::EXTENDED) {
+        uint8_t oldSREG = SREG;
+        cli();
+        Port::out() |= MASK;
+        SREG = oldSREG;
+      }
+      else {
+        Port::out() |= MASK;
+      }
+    }
+    
+    static inline void low() __attribute__((always_inline)) {
+      if (Port::EXTENDED) {
+        uint8_t oldSREG = SREG;
+        cli();
+        Port::out() &= ~MASK;
+        SREG = oldSREG;
+      }
+      else {
+        Port::out() &= ~MASK;
+      }
+    }
+    
+    static inline void write(bool level) __attribute__((always_inline)) {
+      if (level) high();
+      else low();
+    }
+    
+    static inline bool read() __attribute__((always_inline)) {
+      return (Port::out() & MASK) != 0;
+    }
+};
+
+#else
+
+// Off-target builds keep the same interface on top of the Arduino calls
+template <uint8_t PIN>
+class FastPin {
+  public:
+    static inline void output() { pinMode(PIN, OUTPUT); }
+    static inline void high() { digitalWrite(PIN, HIGH); }
+    static inline void low() { digitalWrite(PIN, LOW); }
+    static inline void write(bool level) { digitalWrite(PIN, level ? HIGH : LOW); }
+    static inline bool read() { return digitalRead(PIN) != LOW; }
+};
+
+#endif
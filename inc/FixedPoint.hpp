@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define Q15_ONE 32767
+#define ANGLE_FULL_TURN 65536L
+#define FIXED_ONE 65536L
+#define FIXED_MAX 0x7FFFFFFFL
+
+typedef int32_t fixed_t;
+
+int16_t sinQ15(uint16_t angle);
+int16_t cosQ15(uint16_t angle);
+uint16_t degreesToAngle(float degrees);
+int16_t floatToQ14(float value);
+
+fixed_t floatToFixed(float value);
+float fixedToFloat(fixed_t value);
+fixed_t fixedMul(fixed_t a, fixed_t b);
+uint32_t isqrt32(uint32_t value);
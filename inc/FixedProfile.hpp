@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedPoint.hpp"
+#include "RampTable.hpp"
+
+class FixedProfile {
+  private:
+    fixed_t _maxSpeed;
+    fixed_t _speed;
+    RampTable* _ramp;
+    uint32_t _acceleration;
+    uint32_t _rampRate;
+    uint32_t _cruiseDistance;
+    
+    void updateLimits();
+    fixed_t targetSpeed(long distanceToGo, fixed_t exitSpeed);
+
+  public:
+    FixedProfile();
+
+    void setMaxSpeed(float speed);
+    void setAcceleration(float accel);
+    bool setJerk(float jerk);
+    void setRampTable(RampTable* table);
+    void reset(float speed = 0.0);
+    void resetFixed(fixed_t speed);
+    float update(long distanceToGo, float dt, float exitSpeed = 0.0);
+    fixed_t updateFixed(long distanceToGo, unsigned long dtMicros, fixed_t exitSpeed = 0);
+
+    float getSpeed();
+    fixed_t getSpeedFixed();
+    float getMaxSpeed();
+    float getAcceleration();
+    float getJerk();
+    long stoppingDistance();
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "StepperConfig.hpp"
+
+enum MailboxKind {
+  MAILBOX_EMPTY = 0,
+  MAILBOX_MOVE = 1,
+  MAILBOX_PATH = 2
+};
+
+// Latest-wins slot for absolute targets. MOVE holds independent per-axis
+// targets, PATH one coordinated move for every axis; a newer post overwrites
+// whatever has not been applied yet
+class Mailbox {
+  private:
+    bool _enabled;
+    uint8_t _kind;
+    uint8_t _mask;
+    long _targets[MAX_MOTORS];
+    unsigned long _postedAt;
+    unsigned long _appliedAt;
+    
+  public:
+    Mailbox();
+    
+    void setEnabled(bool enabled);
+    bool isEnabled();
+    
+    // Returns how many unapplied axis targets the post overwrote
+    uint8_t post(uint8_t kind, uint8_t mask, const long targets[], unsigned long now);
+    void clear();
+    
+    bool isEmpty();
+    bool isDue(unsigned long now);
+    uint8_t getKind();
+    uint8_t getMask();
+    long getTarget(uint8_t motor);
+    
+    // Marks the slot empty and returns the age of the newest target in it
+    unsigned long take(unsigned long now);
+};
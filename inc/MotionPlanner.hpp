@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Motor.hpp"
+#include "StepperConfig.hpp"
+
+struct PlannerSegment {
+  long target[PLANNER_AXES];
+  float length;
+  float nominalSpeed;
+  float acceleration;
+  float maxEntrySpeed;
+  float entrySpeed;
+};
+
+class MotionPlanner {
+  private:
+    PlannerSegment _segments[PLANNER_QUEUE_SIZE];
+    uint8_t _head;
+    uint8_t _count;
+    Motor* _motors;
+    uint8_t _axisCount;
+    long _position[PLANNER_AXES];
+    float _previousUnit[PLANNER_AXES];
+    float _previousNominal;
+    bool _hasPrevious;
+    
+    uint8_t indexOf(uint8_t offset);
+    
+  public:
+    MotionPlanner();
+    
+    void begin(Motor* motors, uint8_t axisCount);
+    void sync();
+    bool push(const long targets[]);
+    void recalculate();
+    
+    PlannerSegment* peek();
+    void pop();
+    void clear();
+    
+    bool isEmpty();
+    bool isFull();
+    uint8_t getCount();
+    uint8_t getFree();
+    uint8_t getAxisCount();
+    float getExitSpeed();
+    
+    // Junction deviation speed for a turn between two directions whose unit
+    // vectors have dot product <dot>: <limit> straight on, 0 for a reversal
+    static float junctionSpeed(float dot, float acceleration, float limit);
+};
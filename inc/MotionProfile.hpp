@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedProfile.hpp"
+#include "RampTable.hpp"
+#include "StepperConfig.hpp"
+
+class MotionProfile {
+  private:
+    float _maxSpeed;
+    float _acceleration;
+    float _speed;
+    RampTable* _ramp;
+    
+    float _jerk;
+    float _window;
+    float _leadSpeed;
+    float _lead;
+    int8_t _leadTrend;
+    float _settled;
+    float _history[SCURVE_WINDOW_SLOTS];
+    float _historySum;
+    float _slotSteps;
+    float _slotTime;
+    uint8_t _slot;
+    
+    float ramp(float speed, long distanceToGo, float dt, float exitSpeed);
+    void updateWindow();
+    float smooth(float dt);
+    float lead(long ahead, float dt, float exitSpeed);
+
+  public:
+    MotionProfile();
+
+    void setMaxSpeed(float speed);
+    void setAcceleration(float accel);
+    bool setJerk(float jerk);
+    void setRampTable(RampTable* table);
+    void reset(float speed = 0.0);
+    float update(long distanceToGo, float dt, float exitSpeed = 0.0);
+
+    float getSpeed();
+    float getMaxSpeed();
+    float getAcceleration();
+    float getJerk();
+    long stoppingDistance();
+};
+
+#if FIXED_POINT_PROFILE
+typedef FixedProfile StepProfile;
+#else
+typedef MotionProfile StepProfile;
+#endif
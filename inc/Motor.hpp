@@ -2,58 +2,138 @@
 
 #include <Arduino.h>
 #include "AccelStepper.h"
+#include "PinDriver.hpp"
 #include "StepperConfig.hpp"
+#include "MotionProfile.hpp"
+#include "RampTable.hpp"
+#include "StepTimer.hpp"
+#include "OutputBuffer.hpp"
 
 class Motor {
   private:
-    uint8_t _index;
+    MotorStorage _storage;
     AccelStepper* _stepper;
-    uint8_t _enablePin;
-    MotorState _state;
-    bool _enableInverted;
-    bool _directionInverted;
+    PinDriver* _driver;
     long _homePosition;
     long _maxPosition;
     long _minPosition;
     float _stepsPerUnit;
-    bool _limitActive;
-    bool _calibrated;
+    float _unitsPerStep;
+    uint8_t _index;
+    uint8_t _enablePin;
+    uint8_t _timerChannel;
+    uint8_t _limitPin;
+    int8_t _homingDirection;
+    MotorState _state : 3;
+    HomingPhase _homingPhase : 2;
+    bool _limitActiveLow : 1;
+    bool _enableInverted : 1;
+    bool _directionInverted : 1;
+    bool _limitActive : 1;
+    bool _calibrated : 1;
+    bool _external : 1;
+    bool _jog : 1;
+    bool _jogLatencyPending : 1;
+    StepProfile _profile;
+    RampTable _ramp;
+    long _targetPosition;
+    float _speed;
+    unsigned long _lastProfileUpdate;
+    unsigned long _lastStepTime;
+    uint8_t* _activeMask;
+    float _homingFastSpeed;
+    float _homingSlowSpeed;
+    long _homingBackoff;
+    long _homingMark;
+    unsigned long _homingStart;
+    float _jogSpeed;
+    float _jogTarget;
+    unsigned long _jogCommandTime;
+    unsigned long _jogStartTime;
+    long _jogStartPosition;
+    unsigned long _jogLatency;
+    long _positionShift;
+    
+    void runTimed();
+    void runShaped();
+    void rebuildRamp();
+    void setState(MotorState state);
+    void runHoming();
+    void runJog();
+    void driveAt(float speed);
+    void finishHoming(MotorState state);
+    float limitSpeed(float speed);
 
   public:
     Motor();
     
-    void init(uint8_t index, AccelStepper* stepper, uint8_t enablePin, bool enableInverted = false);
+    MotorStorage* getStorage();
+    void init(uint8_t index, AccelStepper* stepper, PinDriver* driver, uint8_t enablePin, bool enableInverted = false);
+    void attachTimer(uint8_t channel);
+    void setActiveMask(uint8_t* mask);
     void setStepsPerUnit(float stepsPerUnit);
     void setLimits(long minPosition, long maxPosition, bool active = true);
     void setHomePosition(long homePosition);
     void invertDirection(bool inverted);
+    void setLimitSwitch(uint8_t pin, int8_t direction = -1, bool activeLow = true);
+    void setHomingSpeeds(float fastSpeed, float slowSpeed, long backoffSteps);
     
     void calibrateHome();
     void calibrateMin();
     void calibrateMax();
     bool isCalibrated();
+    void setCalibrated(bool calibrated);
     
     void enable(bool enabled = true);
     void disable();
     void setMaxSpeed(float speed);
     void setAcceleration(float accel);
+    bool setJerk(float jerk);
     void setSpeed(float speed);
-    void moveTo(long position);
-    void moveToUnit(float position);
-    void move(long relativeSteps);
-    void moveUnit(float units);
+    bool moveTo(long position);
+    bool moveToUnit(float position);
+    bool move(long relativeSteps);
+    bool moveUnit(float units);
     void stop();
     void runSpeed();
     void run();
     void home();
+    void jog(float velocity);
+    
+    long limitPosition(long position);
+    void beginExternal(long target);
+    void endExternal();
+    void step(int8_t direction);
+    void follow(long position, float velocity);
     
     MotorState getState();
     long getCurrentPosition();
     float getCurrentPositionUnit();
+    float getStepsPerUnit();
     long getTargetPosition();
     float getTargetPositionUnit();
     bool isRunning();
+    bool isHoming();
+    bool isJogging();
+    unsigned long takeJogLatency();
+    
+    // How far explicit position changes (re-zeroing after homing) moved the
+    // count since the last call, so step counters do not mistake it for motion
+    long takePositionShift();
+    bool isDirectionInverted();
+    bool isLimitActive();
+    bool hasLimitSwitch();
+    bool isLimitTriggered();
     bool isEnabled();
+    bool isTimerDriven();
+    bool isExternallyDriven();
+    uint8_t getTimerChannel();
+    float getMaxSpeed();
+    float getAcceleration();
+    float getJerk();
+    float getSpeed();
+    unsigned long getTimeToNextStep(unsigned long now);
+    RampTable* getRampTable();
     long distanceToGo();
     long getHomePosition();
     long getMinPosition();
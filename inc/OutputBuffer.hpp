@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "StepperConfig.hpp"
+
+class OutputBuffer : public Print {
+  private:
+    uint8_t _buffer[OUTPUT_BUFFER_SIZE];
+    uint16_t _head;
+    uint16_t _count;
+    bool _quiet;
+    bool _lineStart;
+    bool _dropping;
+    unsigned long _dropped;
+    
+    void push(uint8_t data);
+    
+  public:
+    OutputBuffer();
+    
+    virtual size_t write(uint8_t data);
+    using Print::write;
+    size_t writeVerbose(uint8_t data);
+    
+    void drain();
+    void flush();
+    
+    uint16_t getPending();
+    uint16_t getFree();
+    unsigned long getDropped();
+    void setQuiet(bool quiet);
+    bool isQuiet();
+};
+
+class VerboseOutput : public Print {
+  public:
+    virtual size_t write(uint8_t data);
+    using Print::write;
+};
+
+extern OutputBuffer Output;
+extern VerboseOutput Verbose;
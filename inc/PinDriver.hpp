@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include "AccelStepper.h"
+#include "FastPin.hpp"
+
+// Step/dir/enable outputs of one driver, written through the Arduino pin calls
+class PinDriver {
+  protected:
+    uint8_t _stepPin;
+    uint8_t _dirPin;
+    uint8_t _enablePin;
+    bool _directionInverted;
+    
+  public:
+    PinDriver(uint8_t stepPin, uint8_t dirPin, uint8_t enablePin);
+    
+    void setDirectionInverted(bool inverted);
+    
+    virtual void begin();
+    virtual void step(bool forward);
+    virtual void writeEnable(bool level);
+    virtual bool readEnable();
+};
+
+// Same outputs with the pins fixed at compile time and written straight to the port registers
+template <uint8_t STEP_PIN, uint8_t DIR_PIN, uint8_t ENABLE_PIN>
+class FastPinDriver : public PinDriver {
+  public:
+    FastPinDriver() : PinDriver(STEP_PIN, DIR_PIN, ENABLE_PIN) {}
+    
+    virtual void begin() {
+      FastPin<STEP_PIN>::output();
+      FastPin<DIR_PIN>::output();
+      if (ENABLE_PIN != 0xFF) {
+        FastPin<ENABLE_PIN>::output();
+      }
+    }
+    
+    virtual void step(bool forward) {
+      FastPin<DIR_PIN>::write(forward != _directionInverted);
+      FastPin<STEP_PIN>::high();
+      delayMicroseconds(1);
+      FastPin<STEP_PIN>::low();
+    }
+    
+    virtual void writeEnable(bool level) {
+      if (ENABLE_PIN != 0xFF) {
+        FastPin<ENABLE_PIN>::write(level);
+      }
+    }
+    
+    virtual bool readEnable() {
+      return ENABLE_PIN != 0xFF && FastPin<ENABLE_PIN>::read();
+    }
+};
+
+// AccelStepper in DRIVER mode that emits its steps through a PinDriver
+class DriverStepper : public AccelStepper {
+  private:
+    PinDriver* _driver;
+    
+  protected:
+    virtual void step(long step);
+    
+  public:
+    DriverStepper(PinDriver* driver, uint8_t stepPin, uint8_t dirPin);
+};
+
+// Room for one motor's stepper and pin driver, built in place instead of on the heap.
+// Sized for the largest types that go in: DriverStepper and PinDriver (FastPinDriver adds no members).
+struct MotorStorage {
+  alignas(DriverStepper) uint8_t stepper[sizeof(DriverStepper)];
+  alignas(PinDriver) uint8_t driver[sizeof(PinDriver)];
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedPoint.hpp"
+#include "StepperConfig.hpp"
+
+// Attachments are stored in Q8 and multiplied by Q15 terms in a long, so
+// they must stay within this many units of the platform centre
+#define PLATFORM_MAX_ATTACHMENT 256.0
+
+class PlatformKinematics {
+  private:
+    long _x[MAX_MOTORS];
+    long _y[MAX_MOTORS];
+    
+  public:
+    PlatformKinematics();
+    
+    bool setAttachment(uint8_t axis, float x, float y);
+    float getAttachmentX(uint8_t axis);
+    float getAttachmentY(uint8_t axis);
+    
+    void solveEuler(uint16_t roll, uint16_t pitch, long heave, uint8_t axisCount, long offsets[]);
+    void solveQuaternion(int16_t w, int16_t x, int16_t y, int16_t z, long heave, uint8_t axisCount, long offsets[]);
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include "FixedPoint.hpp"
+#include "StepperConfig.hpp"
+
+#if RAMP_TABLE_SIZE < 2 || RAMP_TABLE_SIZE > 64
+#error "RAMP_TABLE_SIZE must be between 2 and 64"
+#endif
+
+class RampTable {
+  private:
+#if RAMP_TABLE_PROGMEM
+    uint32_t _scale;
+#else
+    uint16_t _speeds[RAMP_TABLE_SIZE];
+#endif
+    uint16_t _maxSpeed;
+    uint32_t _rampSteps;
+    uint32_t _doubleAccel;
+    uint8_t _shift;
+    bool _valid;
+    
+    uint16_t entry(uint8_t index);
+    
+  public:
+    RampTable();
+    
+    void build(float maxSpeed, float acceleration);
+    void clear();
+    fixed_t speedAt(uint32_t distance);
+    
+    bool isValid();
+    uint32_t getRampSteps();
+    uint32_t getStride();
+    uint8_t getEntryCount();
+    uint16_t getMemoryUsage();
+};
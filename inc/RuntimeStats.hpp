@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+#include "StepperConfig.hpp"
+
+// Always-on counters for spotting a starved loop in the field
+class RuntimeStats {
+  private:
+    unsigned long _lastUpdate;
+    bool _started;
+    unsigned long _resetTime;
+    unsigned long _updates;
+    unsigned long _maxPeriod;
+    unsigned long _histogram[STATS_HISTOGRAM_BUCKETS];
+    unsigned long _maxCommandTime;
+    unsigned long _rxOverflows;
+    long _lastPosition[MAX_MOTORS];
+    unsigned long _steps[MAX_MOTORS];
+    unsigned long _lateSteps[MAX_MOTORS];
+    unsigned long _jogLatency[MAX_MOTORS];
+    unsigned long _maxJogLatency[MAX_MOTORS];
+    unsigned long _mailboxApplied;
+    unsigned long _mailboxCoalesced;
+    unsigned long _staleness;
+    unsigned long _maxStaleness;
+    
+  public:
+    RuntimeStats();
+    
+    void reset();
+    
+    // Returns the time since the previous update() in microseconds
+    unsigned long recordUpdate(unsigned long now);
+    void recordCommand(unsigned long elapsed);
+    void recordRxOverflow();
+    void recordPosition(uint8_t motor, long position);
+    
+    // Moves the reference for the next recordPosition() when the count was
+    // changed without stepping
+    void shiftPosition(uint8_t motor, long shift);
+    void recordLateStep(uint8_t motor);
+    void recordJogLatency(uint8_t motor, unsigned long latency);
+    void recordCoalesced(uint8_t count);
+    
+    // Age in microseconds of a mailbox target when it was applied
+    void recordStaleness(unsigned long age);
+    
+    unsigned long getUpdates();
+    unsigned long getMaxPeriod();
+    unsigned long getHistogram(uint8_t bucket);
+    unsigned long getMaxCommandTime();
+    unsigned long getRxOverflows();
+    unsigned long getSteps(uint8_t motor);
+    unsigned long getLateSteps(uint8_t motor);
+    unsigned long getMaxJogLatency(uint8_t motor);
+    unsigned long getMailboxCoalesced();
+    unsigned long getMaxStaleness();
+    
+    void print(Print& out, uint8_t motorCount);
+};
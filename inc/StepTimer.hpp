@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include "StepperConfig.hpp"
+#include "FixedPoint.hpp"
+
+struct StepChannel {
+  uint8_t stepPin;
+  uint8_t dirPin;
+  volatile uint8_t* stepPort;
+  volatile uint8_t* dirPort;
+  uint8_t stepMask;
+  uint8_t dirMask;
+  bool dirInverted;
+  bool pulseHigh;
+  volatile int8_t direction;
+  volatile uint16_t rate;
+  uint16_t accumulator;
+  volatile long position;
+  volatile long stopAt;
+};
+
+class StepTimer {
+  private:
+    StepChannel _channels[MAX_MOTORS];
+    uint8_t _channelCount;
+    bool _running;
+    volatile unsigned long _ticks;
+    
+    volatile uint8_t _groupMask;
+    volatile uint16_t _groupRate;
+    uint16_t _groupAccumulator;
+    volatile long _groupRemaining;
+    long _groupTotal;
+    long _groupDelta[MAX_MOTORS];
+    long _groupError[MAX_MOTORS];
+    
+    void writeDirection(StepChannel& channel);
+    static uint16_t speedToRate(fixed_t speed);
+    
+  public:
+    StepTimer();
+    
+    uint8_t attach(uint8_t stepPin, uint8_t dirPin);
+    void begin();
+    void end();
+    bool isRunning();
+    
+    void setMotion(uint8_t channel, fixed_t speed, long stopAt);
+    void setDirectionInverted(uint8_t channel, bool inverted);
+    void setPosition(uint8_t channel, long position);
+    long getPosition(uint8_t channel);
+    bool isStepping(uint8_t channel);
+    unsigned long getTicks();
+    
+    void beginGroup(uint8_t mask, const long deltas[], long totalSteps);
+    void setGroupRate(fixed_t speed);
+    long getGroupRemaining();
+    void endGroup();
+    
+    void tick();
+    
+#ifndef __AVR__
+    void advance(unsigned long ticks);
+#endif
+};
+
+extern StepTimer stepTimer;
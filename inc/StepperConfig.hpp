@@ -2,11 +2,68 @@
 
 #define SERIAL_BAUD_RATE 115200
 #define COMMAND_BUFFER_SIZE 64
+#define OUTPUT_BUFFER_SIZE 256
+#define OUTPUT_LINE_RESERVE 64
+#define COMMAND_NAME_SIZE 20
+#define COMMAND_SCHEMA_SIZE 8
+#define COMMAND_MAX_NUMBERS 5
+#define COMMAND_HELP_SIZE 80
+#define MAX_USER_COMMANDS 8
+#define BINARY_SYNC_BYTE 0xA5
+// Largest frame is telemetry: 6 header bytes plus 9 per motor
+#define BINARY_MAX_PAYLOAD 42
 
-#define MAX_MOTORS 8
+// Storage for every motor is reserved up front; the platform drives four
+#define MAX_MOTORS 4
 
 #define MOTOR_INTERFACE_TYPE 1
 
+// Build with -DSTEP_TIMER_ENABLED=1 to step from the timer interrupt
+#ifndef STEP_TIMER_ENABLED
+#define STEP_TIMER_ENABLED 0
+#endif
+#define STEP_TIMER_FREQUENCY 20000
+
+// Build with -DFIXED_POINT_PROFILE=1 for the Q16.16 profiles
+#ifndef FIXED_POINT_PROFILE
+#define FIXED_POINT_PROFILE 0
+#endif
+#define RAMP_TABLE_SIZE 32
+#define RAMP_TABLE_PROGMEM 0
+#define SCURVE_WINDOW_SLOTS 8
+
+#define STATS_HISTOGRAM_BUCKETS 16
+#define STATS_LATE_STEP_US 200
+
+#define TELEMETRY_MIN_INTERVAL 5
+
+#define PLANNER_QUEUE_SIZE 8
+#define PLANNER_AXES 4
+#define PLANNER_JUNCTION_DEVIATION 4.0
+
+#define TRAJECTORY_QUEUE_SIZE 8
+#define TRAJECTORY_AXES 4
+#define TRAJECTORY_INTERVAL_US 1000
+#define TRAJECTORY_CATCHUP 50.0
+
+#define JOG_INTERVAL_US 1000
+#define JOG_TIMEOUT_MS 250
+
+// Coalesced targets are applied at most this often, and never mid-retarget
+#define MAILBOX_INTERVAL_US 5000
+
+#define HOMING_FAST_SPEED 400.0
+#define HOMING_SLOW_SPEED 50.0
+#define HOMING_BACKOFF_STEPS 100
+#define HOMING_TIMEOUT_MS 30000UL
+
+// Bump CONFIG_VERSION whenever ConfigRecord changes; older records are ignored
+#define CONFIG_VERSION 1
+#define CONFIG_EEPROM_BASE 0
+#define CONFIG_SLOTS 8
+#define CONFIG_SAVE_DELAY_MS 2000
+#define CONFIG_CHECK_INTERVAL_MS 250
+
 #define X_STEP_PIN     54
 #define X_DIR_PIN      55
 #define X_ENABLE_PIN   38
@@ -23,10 +80,17 @@
 #define A_DIR_PIN      28
 #define A_ENABLE_PIN   24
 
+#define X_LIMIT_PIN    3
+#define Y_LIMIT_PIN    14
+#define Z_LIMIT_PIN    18
+
 #define DEFAULT_MAX_SPEED 1000.0
 #define DEFAULT_ACCELERATION 500.0
 #define DEFAULT_STEPS_PER_UNIT 80.0
 
+#define PLATFORM_HALF_WIDTH 100.0
+#define PLATFORM_HALF_DEPTH 100.0
+
 enum MotorState {
   STOPPED = 0,
   RUNNING = 1,
@@ -35,6 +99,12 @@ enum MotorState {
   ERROR = 4
 };
 
+enum HomingPhase {
+  HOMING_SEEK = 0,
+  HOMING_BACKOFF = 1,
+  HOMING_APPROACH = 2
+};
+
 enum MotorDirection {
   CLOCKWISE = 1,
   COUNTERCLOCKWISE = -1
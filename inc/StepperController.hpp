@@ -1,19 +1,77 @@
 #pragma once
 #include <Arduino.h>
+#include <new>
 #include "Motor.hpp"
+#include "CoordinatedMove.hpp"
+#include "MotionPlanner.hpp"
+#include "BinaryProtocol.hpp"
+#include "Commands.hpp"
+#include "PlatformKinematics.hpp"
+#include "RuntimeStats.hpp"
+#include "Telemetry.hpp"
+#include "Trajectory.hpp"
+#include "ConfigStore.hpp"
+#include "Mailbox.hpp"
 #include "StepperConfig.hpp"
 
+#if MAX_MOTORS > 8
+#error "The active-motor bitmask holds at most 8 motors"
+#endif
+
 class StepperController {
   private:
     Motor _motors[MAX_MOTORS];
     uint8_t _motorCount;
+    uint8_t _activeMask;
     bool _emergencyStop;
     unsigned long _lastUpdateTime;
+    CoordinatedMove _coordinatedMove;
+    MotionPlanner _planner;
+    Trajectory _trajectory;
+    PlatformKinematics _kinematics;
+    BinaryProtocol _binary;
+    bool _binaryMode;
+    UserCommand _userCommands[MAX_USER_COMMANDS];
+    uint8_t _userCommandCount;
+    RuntimeStats _stats;
+    Telemetry _telemetry;
+    ConfigStore _config;
+    Mailbox _mailbox;
+    
+    void startNextSegment();
+    void releaseAxes();
+    uint8_t attachMotor(AccelStepper* stepper, PinDriver* driver, uint8_t stepPin, uint8_t dirPin, uint8_t enablePin, bool enableInverted);
+    bool applyPose(const long offsets[]);
+    bool checkTargets(const long targets[]);
+    bool postPath(const long targets[]);
+    void postToMailbox(uint8_t kind, uint8_t mask, const long targets[]);
+    void flushMailbox();
+    void recordSteps(unsigned long period);
+    uint8_t getTelemetryFlags();
+    bool dispatchCommand(const char* command);
+    bool parseArguments(const char* schema, CommandArgs& args);
+    void handleBinaryFrame();
+    void sendBinaryReply(uint8_t opcode, uint8_t status, const uint8_t* data = NULL, uint8_t length = 0);
     
   public:
     StepperController();
     
     uint8_t addMotor(uint8_t stepPin, uint8_t dirPin, uint8_t enablePin, uint8_t interface = 1, bool enableInverted = false);
+    
+    // Pins known at compile time are written straight to the port registers
+    template <uint8_t STEP_PIN, uint8_t DIR_PIN, uint8_t ENABLE_PIN>
+    uint8_t addMotor(bool enableInverted = false) {
+      if (_motorCount >= MAX_MOTORS) {
+        return 0xFF;
+      }
+      
+      static_assert(sizeof(FastPinDriver<STEP_PIN, DIR_PIN, ENABLE_PIN>) <= sizeof(MotorStorage::driver), "FastPinDriver outgrew MotorStorage");
+      
+      MotorStorage* storage = _motors[_motorCount].getStorage();
+      PinDriver* driver = new (storage->driver) FastPinDriver<STEP_PIN, DIR_PIN, ENABLE_PIN>();
+      AccelStepper* stepper = new (storage->stepper) DriverStepper(driver, STEP_PIN, DIR_PIN);
+      return attachMotor(stepper, driver, STEP_PIN, DIR_PIN, ENABLE_PIN, enableInverted);
+    }
     Motor* getMotor(uint8_t index);
     void enableAll();
     void disableAll();
@@ -24,6 +82,22 @@ class StepperController {
     void stopAll();
     void homeAll();
     void runAll();
+    bool moveToAll(const long targets[]);
+    bool setTargets(const long targets[]);
+    bool postMove(uint8_t motor, long position);
+    bool postTargets(const long targets[]);
+    void setCoalescing(bool enabled);
+    bool isCoalescing();
+    bool jog(uint8_t motor, float velocity);
+    bool jogAll(const float velocities[]);
+    bool queueMove(const long targets[]);
+    uint8_t getQueueFree();
+    bool pushWaypoint(const long positions[], const float velocities[], uint16_t duration);
+    uint8_t getTrajectoryFree();
+    Trajectory* getTrajectory();
+    bool setPose(float roll, float pitch, float heave);
+    bool setPoseQuaternion(float w, float x, float y, float z, float heave);
+    PlatformKinematics* getKinematics();
     
     void calibrateHomeAll();
     void calibrateMinAll();
@@ -31,11 +105,27 @@ class StepperController {
     
     uint8_t getMotorCount();
     bool isAnyRunning();
+    bool isAnyHoming();
+    uint8_t getActiveMask();
+    unsigned long getTimeToNextStep();
+    bool isCoordinatedMoveActive();
     bool isEmergencyStopped();
     unsigned long getLastUpdateTime();
     void printStatus();
+    void printRampTables();
+    void printStats();
+    void printMemory();
+    RuntimeStats* getStats();
+    Telemetry* getTelemetry();
+    bool loadConfig();
+    ConfigStore* getConfig();
+    void printHelp();
     
     void update();
     bool processCommand(const char* command);
+    bool registerCommand(const char* name, const char* schema, CommandHandler handler, const char* help = NULL);
+    void processBinaryByte(uint8_t data);
+    void setBinaryMode(bool enabled);
+    bool isBinaryMode();
 };
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Motor.hpp"
+#include "OutputBuffer.hpp"
+#include "StepperConfig.hpp"
+
+#define TELEMETRY_HEADER_SIZE 6
+#define TELEMETRY_MOTOR_SIZE 9
+
+#if TELEMETRY_HEADER_SIZE + MAX_MOTORS * TELEMETRY_MOTOR_SIZE > BINARY_MAX_PAYLOAD
+#error "Telemetry for MAX_MOTORS motors does not fit in a binary frame"
+#endif
+
+// Per-motor state bits in a telemetry frame
+#define TELEMETRY_RUNNING 0x01
+#define TELEMETRY_ENABLED 0x02
+#define TELEMETRY_EXTERNAL 0x04
+#define TELEMETRY_CALIBRATED 0x08
+
+// Controller state bits in a telemetry frame
+#define TELEMETRY_EMERGENCY_STOP 0x01
+#define TELEMETRY_COORDINATED 0x02
+#define TELEMETRY_QUEUED 0x04
+#define TELEMETRY_TRAJECTORY 0x08
+
+// Pushes OP_TELEMETRY frames at a fixed rate. A snapshot is taken when a frame
+// is due, then written one motor at a time and only into free output space, so
+// a frame is spread over several loop iterations instead of stalling one.
+//
+// Payload: millis (u32), controller flags (u8), motor count (u8), then per
+// motor position (i32), target (i32) and state bits (u8), all little-endian.
+class Telemetry {
+  private:
+    Motor* _motors;
+    uint8_t _motorCount;
+    unsigned long _interval;
+    unsigned long _lastFrame;
+    uint16_t _framesSent;
+    
+    // Frame in progress
+    bool _sending;
+    uint8_t _stage;
+    uint16_t _crc;
+    unsigned long _timestamp;
+    uint8_t _flags;
+    uint8_t _count;
+    long _position[MAX_MOTORS];
+    long _target[MAX_MOTORS];
+    uint8_t _state[MAX_MOTORS];
+    
+    void writeByte(uint8_t data);
+    void writeInt32(int32_t value);
+    
+  public:
+    Telemetry();
+    
+    void begin(Motor* motors, uint8_t motorCount);
+    
+    // 0 stops the stream; shorter intervals are raised to TELEMETRY_MIN_INTERVAL
+    void setInterval(unsigned long intervalMs);
+    unsigned long getInterval();
+    uint16_t getFramesSent();
+    
+    bool isDue();
+    void capture(uint8_t flags);
+    void send();
+};
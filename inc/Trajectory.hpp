@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Motor.hpp"
+#include "StepperConfig.hpp"
+
+#if 2 + TRAJECTORY_AXES * 8 > BINARY_MAX_PAYLOAD
+#error "TRAJECTORY_AXES waypoints do not fit in a binary frame"
+#endif
+
+// Arrive at position with velocity (steps/s), duration ms after the previous waypoint
+struct Waypoint {
+  long position[TRAJECTORY_AXES];
+  float velocity[TRAJECTORY_AXES];
+  uint16_t duration;
+};
+
+// Plays back streamed position/velocity/time waypoints. Between waypoints every
+// axis follows a cubic Hermite curve; the setpoint is refreshed every
+// TRAJECTORY_INTERVAL_US and the motors chase it with a feed-forward velocity.
+// If the queue runs dry the axes hold the last waypoint and an underrun is
+// counted unless that waypoint came to rest.
+class Trajectory {
+  private:
+    Waypoint _points[TRAJECTORY_QUEUE_SIZE];
+    uint8_t _head;
+    uint8_t _count;
+    Motor* _motors;
+    uint8_t _axisCount;
+    
+    bool _active;
+    bool _holding;
+    unsigned long _segmentStart;
+    unsigned long _lastFollow;
+    long _from[TRAJECTORY_AXES];
+    float _fromVelocity[TRAJECTORY_AXES];
+    uint16_t _underruns;
+    
+    void start();
+    void interpolate(unsigned long elapsed);
+    void hold();
+    void finish();
+    
+  public:
+    Trajectory();
+    
+    void begin(Motor* motors, uint8_t axisCount);
+    bool push(const long positions[], const float velocities[], uint16_t duration);
+    void run();
+    void clear();
+    
+    bool isActive();
+    uint8_t getFree();
+    uint8_t getAxisCount();
+    uint16_t getUnderruns();
+};
@@ -0,0 +1,153 @@
+#include "../inc/BinaryProtocol.hpp"
+
+BinaryProtocol::BinaryProtocol() {
+  _crcErrors = 0;
+  reset();
+}
+
+void BinaryProtocol::reset() {
+  _state = WAIT_SYNC;
+  _length = 0;
+  _opcode = 0;
+  _received = 0;
+  _crc = 0xFFFF;
+  _frameCrc = 0;
+}
+
+bool BinaryProtocol::feed(uint8_t data) {
+  switch (_state) {
+    case WAIT_SYNC:
+      if (data == BINARY_SYNC_BYTE) {
+        reset();
+        _state = WAIT_LENGTH;
+      }
+      return false;
+      
+    case WAIT_LENGTH:
+      if (data > BINARY_MAX_PAYLOAD) {
+        reset();
+        return false;
+      }
+      _length = data;
+      _crc = crc16(_crc, data);
+      _state = WAIT_OPCODE;
+      return false;
+      
+    case WAIT_OPCODE:
+      _opcode = data;
+      _crc = crc16(_crc, data);
+      _state = _length > 0 ? WAIT_PAYLOAD : WAIT_CRC_LOW;
+      return false;
+      
+    case WAIT_PAYLOAD:
+      _payload[_received++] = data;
+      _crc = crc16(_crc, data);
+      if (_received >= _length) {
+        _state = WAIT_CRC_LOW;
+      }
+      return false;
+      
+    case WAIT_CRC_LOW:
+      _frameCrc = data;
+      _state = WAIT_CRC_HIGH;
+      return false;
+      
+    case WAIT_CRC_HIGH:
+      _frameCrc |= (uint16_t)data << 8;
+      _state = WAIT_SYNC;
+      if (_frameCrc != _crc) {
+        _crcErrors++;
+      }
+      return true;
+  }
+  
+  return false;
+}
+
+bool BinaryProtocol::hasCrcError() {
+  return _frameCrc != _crc;
+}
+
+uint8_t BinaryProtocol::getOpcode() {
+  return _opcode;
+}
+
+uint8_t BinaryProtocol::getLength() {
+  return _length;
+}
+
+const uint8_t* BinaryProtocol::getPayload() {
+  return _payload;
+}
+
+uint16_t BinaryProtocol::getCrcErrors() {
+  return _crcErrors;
+}
+
+uint16_t BinaryProtocol::crc16(uint16_t crc, uint8_t data) {
+  crc ^= (uint16_t)data << 8;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint8_t BinaryProtocol::encode(uint8_t* frame, uint8_t opcode, const uint8_t* payload, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  uint8_t size = 0;
+  
+  frame[size++] = BINARY_SYNC_BYTE;
+  frame[size++] = length;
+  crc = crc16(crc, length);
+  frame[size++] = opcode;
+  crc = crc16(crc, opcode);
+  
+  for (uint8_t i = 0; i < length; i++) {
+    frame[size++] = payload[i];
+    crc = crc16(crc, payload[i]);
+  }
+  
+  frame[size++] = crc & 0xFF;
+  frame[size++] = crc >> 8;
+  return size;
+}
+
+void BinaryProtocol::send(Print& out, uint8_t opcode, const uint8_t* payload, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  
+  out.write(BINARY_SYNC_BYTE);
+  out.write(length);
+  crc = crc16(crc, length);
+  out.write(opcode);
+  crc = crc16(crc, opcode);
+  
+  for (uint8_t i = 0; i < length; i++) {
+    out.write(payload[i]);
+    crc = crc16(crc, payload[i]);
+  }
+  
+  out.write((uint8_t)(crc & 0xFF));
+  out.write((uint8_t)(crc >> 8));
+}
+
+int16_t BinaryProtocol::readInt16(const uint8_t* data) {
+  return (int16_t)((uint16_t)data[0] | ((uint16_t)data[1] << 8));
+}
+
+int32_t BinaryProtocol::readInt32(const uint8_t* data) {
+  return (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+}
+
+float BinaryProtocol::readFloat(const uint8_t* data) {
+  uint32_t bits = (uint32_t)readInt32(data);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void BinaryProtocol::writeInt32(uint8_t* data, int32_t value) {
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+  data[3] = (value >> 24) & 0xFF;
+}
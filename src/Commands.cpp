@@ -0,0 +1,564 @@
+#include "../inc/Commands.hpp"
+#include "../inc/StepperController.hpp"
+
+static bool cmdHelp(StepperController& controller, CommandArgs&) {
+  controller.printHelp();
+  return true;
+}
+
+static bool cmdStatus(StepperController& controller, CommandArgs&) {
+  controller.printStatus();
+  return true;
+}
+
+static bool cmdStats(StepperController& controller, CommandArgs&) {
+  controller.printStats();
+  return true;
+}
+
+static bool cmdStatsReset(StepperController& controller, CommandArgs&) {
+  controller.getStats()->reset();
+  Verbose.println(F("Stats reset"));
+  return true;
+}
+
+static bool cmdTelemetry(StepperController& controller, CommandArgs& args) {
+  if (args.value < 0) {
+    Output.println(F("Error: Interval must not be negative"));
+    return false;
+  }
+  
+  controller.getTelemetry()->setInterval(args.value);
+  Verbose.print(F("Telemetry interval: "));
+  Verbose.print(controller.getTelemetry()->getInterval());
+  Verbose.println(F(" ms"));
+  return true;
+}
+
+static bool cmdMemory(StepperController& controller, CommandArgs&) {
+  controller.printMemory();
+  return true;
+}
+
+static bool cmdConfig(StepperController& controller, CommandArgs&) {
+  controller.getConfig()->print(Output);
+  return true;
+}
+
+static bool cmdConfigLoad(StepperController& controller, CommandArgs&) {
+  if (controller.isAnyRunning()) {
+    Output.println(F("Error: Motors are moving"));
+    return false;
+  }
+  
+  if (!controller.loadConfig()) {
+    Output.println(F("Error: No saved configuration"));
+    return false;
+  }
+  
+  Verbose.println(F("Configuration loaded"));
+  return true;
+}
+
+static bool cmdConfigSave(StepperController& controller, CommandArgs&) {
+  controller.getConfig()->save();
+  Verbose.println(F("Configuration save requested"));
+  return true;
+}
+
+static bool cmdRamps(StepperController& controller, CommandArgs&) {
+  controller.printRampTables();
+  return true;
+}
+
+static bool cmdEnable(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->enable();
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.println(F(" enabled"));
+  return true;
+}
+
+static bool cmdDisable(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->disable();
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.println(F(" disabled"));
+  return true;
+}
+
+static bool cmdEnableAll(StepperController& controller, CommandArgs&) {
+  controller.enableAll();
+  Verbose.println(F("All motors enabled"));
+  return true;
+}
+
+static bool cmdDisableAll(StepperController& controller, CommandArgs&) {
+  controller.disableAll();
+  Verbose.println(F("All motors disabled"));
+  return true;
+}
+
+// The move still runs, stopping at the limit
+static void reportLimited(uint8_t motor, long position) {
+  Output.print(F("Warning: Motor "));
+  Output.print(motor);
+  Output.print(F(" target limited to "));
+  Output.println(position);
+}
+
+// With coalescing on the target waits in the mailbox instead of reaching the motor
+static void moveMotorTo(StepperController& controller, uint8_t index, long position) {
+  Motor* motor = controller.getMotor(index);
+  bool reached = controller.isCoalescing() ? controller.postMove(index, position) : motor->moveTo(position);
+  
+  if (!reached) {
+    reportLimited(index, motor->limitPosition(position));
+  }
+}
+
+static bool cmdMove(StepperController& controller, CommandArgs& args) {
+  if (!controller.getMotor(args.motor)->move(args.value)) {
+    reportLimited(args.motor, controller.getMotor(args.motor)->getTargetPosition());
+  }
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" moving "));
+  Verbose.print(args.value);
+  Verbose.println(F(" steps"));
+  return true;
+}
+
+static bool cmdMoveto(StepperController& controller, CommandArgs& args) {
+  moveMotorTo(controller, args.motor, args.value);
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" moving to position "));
+  Verbose.println(args.value);
+  return true;
+}
+
+static bool cmdMoveunit(StepperController& controller, CommandArgs& args) {
+  if (!controller.getMotor(args.motor)->moveUnit(args.number)) {
+    reportLimited(args.motor, controller.getMotor(args.motor)->getTargetPosition());
+  }
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" moving "));
+  Verbose.print(args.number);
+  Verbose.println(F(" units"));
+  return true;
+}
+
+static bool cmdMovetounit(StepperController& controller, CommandArgs& args) {
+  moveMotorTo(controller, args.motor, long(args.number * controller.getMotor(args.motor)->getStepsPerUnit()));
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" moving to position "));
+  Verbose.print(args.number);
+  Verbose.println(F(" units"));
+  return true;
+}
+
+// Shared by the *_all commands: one validation, one commit, one acknowledgement
+static bool commitTargets(StepperController& controller, long targets[], bool absolute = false) {
+  bool accepted = absolute && controller.isCoalescing() ? controller.postTargets(targets) : controller.setTargets(targets);
+  if (!accepted) {
+    Output.println(controller.isEmergencyStopped() ? F("Error: Emergency stop active") : F("Error: Target outside limits"));
+    return false;
+  }
+  
+  Verbose.print(F("Moving all motors to"));
+  for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
+    Verbose.print(' ');
+    Verbose.print(targets[i]);
+  }
+  Verbose.println();
+  return true;
+}
+
+static bool cmdMoveAll(StepperController& controller, CommandArgs& args) {
+  for (uint8_t i = 0; i < args.count; i++) {
+    args.values[i] += controller.getMotor(i)->getCurrentPosition();
+  }
+  return commitTargets(controller, args.values);
+}
+
+static bool cmdMovetoAll(StepperController& controller, CommandArgs& args) {
+  return commitTargets(controller, args.values, true);
+}
+
+static bool cmdMoveunitAll(StepperController& controller, CommandArgs& args) {
+  long targets[MAX_MOTORS];
+  for (uint8_t i = 0; i < args.count; i++) {
+    Motor* motor = controller.getMotor(i);
+    targets[i] = motor->getCurrentPosition() + long(args.reals[i] * motor->getStepsPerUnit());
+  }
+  return commitTargets(controller, targets);
+}
+
+static bool cmdMovetounitAll(StepperController& controller, CommandArgs& args) {
+  long targets[MAX_MOTORS];
+  for (uint8_t i = 0; i < args.count; i++) {
+    targets[i] = long(args.reals[i] * controller.getMotor(i)->getStepsPerUnit());
+  }
+  return commitTargets(controller, targets, true);
+}
+
+static bool cmdJog(StepperController& controller, CommandArgs& args) {
+  if (!controller.jog(args.motor, args.number)) {
+    Output.println(F("Error: Emergency stop active"));
+    return false;
+  }
+  
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" jogging at "));
+  Verbose.println(args.number);
+  return true;
+}
+
+static bool cmdJogAll(StepperController& controller, CommandArgs& args) {
+  if (!controller.jogAll(args.reals)) {
+    Output.println(F("Error: Emergency stop active"));
+    return false;
+  }
+  
+  Verbose.println(F("Jogging all motors"));
+  return true;
+}
+
+// The credit line is printed even in quiet mode so a streaming host can pace itself
+static bool cmdPvt(StepperController& controller, CommandArgs& args) {
+  if (args.value <= 0 || args.value > 65535) {
+    Output.println(F("Error: Duration must be 1-65535 ms"));
+    return false;
+  }
+  
+  bool accepted = controller.pushWaypoint(args.values, args.reals, args.value);
+  if (!accepted) {
+    Output.println(controller.isEmergencyStopped() ? F("Error: Emergency stop active") : F("Error: Trajectory buffer full"));
+  }
+  
+  Output.print(F("pvt "));
+  Output.println(controller.getTrajectoryFree());
+  return accepted;
+}
+
+static bool cmdQueue(StepperController& controller, CommandArgs& args) {
+  if (!controller.queueMove(args.values)) {
+    Output.println(F("Error: Move queue full"));
+    return false;
+  }
+  
+  Verbose.print(F("Queued move, free slots: "));
+  Verbose.println(controller.getQueueFree());
+  return true;
+}
+
+static bool cmdPlatform(StepperController& controller, CommandArgs& args) {
+  if (!controller.getKinematics()->setAttachment(args.motor, args.numbers[0], args.numbers[1])) {
+    Output.print(F("Error: Attachment must be within "));
+    Output.print(PLATFORM_MAX_ATTACHMENT);
+    Output.println(F(" units"));
+    return false;
+  }
+  
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" attached at "));
+  Verbose.print(args.numbers[0]);
+  Verbose.print(F(", "));
+  Verbose.println(args.numbers[1]);
+  return true;
+}
+
+static bool reportPose(StepperController& controller, bool accepted) {
+  if (!accepted) {
+    Output.println(controller.isEmergencyStopped() ? F("Error: Emergency stop active") : F("Error: Target outside limits"));
+    return false;
+  }
+  
+  Verbose.println(F("Moving to pose"));
+  return true;
+}
+
+static bool cmdPose(StepperController& controller, CommandArgs& args) {
+  return reportPose(controller, controller.setPose(args.numbers[0], args.numbers[1], args.numbers[2]));
+}
+
+static bool cmdPoseq(StepperController& controller, CommandArgs& args) {
+  return reportPose(controller, controller.setPoseQuaternion(args.numbers[0], args.numbers[1], args.numbers[2], args.numbers[3], args.numbers[4]));
+}
+
+static bool cmdCoalesce(StepperController& controller, CommandArgs& args) {
+  controller.setCoalescing(args.value != 0);
+  Verbose.println(controller.isCoalescing() ? F("Coalescing targets") : F("Applying every target"));
+  return true;
+}
+
+static bool cmdQuiet(StepperController&, CommandArgs& args) {
+  Output.setQuiet(args.value != 0);
+  Verbose.println(F("Quiet mode off"));
+  return true;
+}
+
+static bool cmdHome(StepperController& controller, CommandArgs& args) {
+  if (controller.isEmergencyStopped()) {
+    Output.println(F("Error: Emergency stop active"));
+    return false;
+  }
+  
+  controller.getMotor(args.motor)->home();
+  Verbose.print(F("Homing motor "));
+  Verbose.println(args.motor);
+  return true;
+}
+
+static bool cmdHomeAll(StepperController& controller, CommandArgs&) {
+  if (controller.isEmergencyStopped()) {
+    Output.println(F("Error: Emergency stop active"));
+    return false;
+  }
+  
+  controller.homeAll();
+  Verbose.println(F("Homing all motors"));
+  return true;
+}
+
+static bool cmdEndstop(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->setLimitSwitch((uint8_t)args.numbers[0], args.numbers[1] < 0 ? -1 : 1);
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" endstop on pin "));
+  Verbose.println((uint8_t)args.numbers[0]);
+  return true;
+}
+
+static bool cmdHoming(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->setHomingSpeeds(args.numbers[0], args.numbers[1], (long)args.numbers[2]);
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.println(F(" homing speeds set"));
+  return true;
+}
+
+static bool cmdStop(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->stop();
+  Verbose.print(F("Stopped motor "));
+  Verbose.println(args.motor);
+  return true;
+}
+
+static bool cmdStopAll(StepperController& controller, CommandArgs&) {
+  controller.stopAll();
+  Verbose.println(F("Stopped all motors"));
+  return true;
+}
+
+static bool cmdEmergencyStop(StepperController& controller, CommandArgs&) {
+  controller.emergencyStop();
+  Verbose.println(F("EMERGENCY STOP"));
+  return true;
+}
+
+static bool cmdResume(StepperController& controller, CommandArgs&) {
+  controller.emergencyStop(true);
+  Verbose.println(F("Resumed after emergency stop"));
+  return true;
+}
+
+static bool cmdSpeed(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->setMaxSpeed(args.number);
+  Verbose.print(F("Set motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" speed to "));
+  Verbose.println(args.number);
+  return true;
+}
+
+static bool cmdAccel(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->setAcceleration(args.number);
+  Verbose.print(F("Set motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" acceleration to "));
+  Verbose.println(args.number);
+  return true;
+}
+
+static bool cmdJerk(StepperController& controller, CommandArgs& args) {
+  if (!controller.getMotor(args.motor)->setJerk(args.number)) {
+    Output.println(F("Error: S-curve profiles need FIXED_POINT_PROFILE disabled"));
+    return false;
+  }
+  
+  Verbose.print(F("Set motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" jerk to "));
+  Verbose.println(args.number);
+  return true;
+}
+
+static bool cmdCalibrateHome(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->calibrateHome();
+  return true;
+}
+
+static bool cmdCalibrateMin(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->calibrateMin();
+  return true;
+}
+
+static bool cmdCalibrateMax(StepperController& controller, CommandArgs& args) {
+  controller.getMotor(args.motor)->calibrateMax();
+  return true;
+}
+
+static bool cmdCalibrateHomeAll(StepperController& controller, CommandArgs&) {
+  controller.calibrateHomeAll();
+  return true;
+}
+
+static bool cmdCalibrateMinAll(StepperController& controller, CommandArgs&) {
+  controller.calibrateMinAll();
+  return true;
+}
+
+static bool cmdCalibrateMaxAll(StepperController& controller, CommandArgs&) {
+  controller.calibrateMaxAll();
+  return true;
+}
+
+static bool cmdInvert(StepperController& controller, CommandArgs& args) {
+  bool invert = args.value != 0;
+  controller.getMotor(args.motor)->invertDirection(invert);
+  Verbose.print(F("Motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" direction inverted: "));
+  Verbose.println(invert ? F("YES") : F("NO"));
+  return true;
+}
+
+static bool cmdSetStepsPerUnit(StepperController& controller, CommandArgs& args) {
+  if (args.number <= 0) {
+    Output.println(F("Error: Steps per unit must be positive"));
+    return false;
+  }
+  
+  controller.getMotor(args.motor)->setStepsPerUnit(args.number);
+  Verbose.print(F("Set motor "));
+  Verbose.print(args.motor);
+  Verbose.print(F(" steps per unit to "));
+  Verbose.println(args.number);
+  return true;
+}
+
+static bool cmdBinary(StepperController& controller, CommandArgs&) {
+  Verbose.println(F("Binary mode enabled"));
+  controller.setBinaryMode(true);
+  return true;
+}
+
+static const CommandEntry COMMANDS[] PROGMEM = {
+  {"accel", "mf", "accel <motor> <accel> - Set acceleration", cmdAccel},
+  {"binary", "", "binary - Switch to the binary frame protocol", cmdBinary},
+  {"calibrate_home", "m", "calibrate_home <motor> - Calibrate home position", cmdCalibrateHome},
+  {"calibrate_home_all", "", "calibrate_home_all - Calibrate home position for all motors", cmdCalibrateHomeAll},
+  {"calibrate_max", "m", "calibrate_max <motor> - Calibrate max position", cmdCalibrateMax},
+  {"calibrate_max_all", "", "calibrate_max_all - Calibrate max position for all motors", cmdCalibrateMaxAll},
+  {"calibrate_min", "m", "calibrate_min <motor> - Calibrate min position", cmdCalibrateMin},
+  {"calibrate_min_all", "", "calibrate_min_all - Calibrate min position for all motors", cmdCalibrateMinAll},
+  {"coalesce", "b", "coalesce <0|1> - Apply only the newest moveto/pose target when ready", cmdCoalesce},
+  {"config", "", "config - Show where the saved configuration lives and whether it is current", cmdConfig},
+  {"config_load", "", "config_load - Restore the saved configuration", cmdConfigLoad},
+  {"config_save", "", "config_save - Save the configuration now instead of after it settles", cmdConfigSave},
+  {"disable", "m", "disable <motor> - Disable motor (0-n)", cmdDisable},
+  {"disable_all", "", "disable_all - Disable all motors", cmdDisableAll},
+  {"emergency_stop", "", "emergency_stop - Emergency stop all motors", cmdEmergencyStop},
+  {"enable", "m", "enable <motor> - Enable motor (0-n)", cmdEnable},
+  {"enable_all", "", "enable_all - Enable all motors", cmdEnableAll},
+  {"endstop", "mff", "endstop <motor> <pin> <-1|1> - Set the homing switch and seek direction", cmdEndstop},
+  {"help", "", "help - Show this help message", cmdHelp},
+  {"home", "m", "home <motor> - Home specific motor", cmdHome},
+  {"home_all", "", "home_all - Home all motors", cmdHomeAll},
+  {"homing", "mfff", "homing <motor> <fast> <slow> <backoff> - Set homing speeds and back-off", cmdHoming},
+  {"invert", "mb", "invert <motor> <0|1> - Invert motor direction", cmdInvert},
+  {"jerk", "mf", "jerk <motor> <jerk> - Set jerk limit for S-curve moves (0 = trapezoid)", cmdJerk},
+  {"jog", "mf", "jog <motor> <steps/s> - Ramp to a velocity; resend within the jog timeout", cmdJog},
+  {"jog_all", "F", "jog_all <v0> ... <vN> - Ramp every motor to a velocity in steps/s", cmdJogAll},
+  {"memory", "", "memory - Show static RAM used by the controller and what is free", cmdMemory},
+  {"move", "ml", "move <motor> <steps> - Move motor by steps", cmdMove},
+  {"move_all", "A", "move_all <steps0> ... <stepsN> - Move all motors by steps at once", cmdMoveAll},
+  {"moveto", "ml", "moveto <motor> <position> - Move motor to absolute position", cmdMoveto},
+  {"moveto_all", "A", "moveto_all <pos0> ... <posN> - Move all motors to positions at once", cmdMovetoAll},
+  {"movetounit", "mf", "movetounit <motor> <position> - Move motor to absolute position in units", cmdMovetounit},
+  {"movetounit_all", "F", "movetounit_all <pos0> ... <posN> - Move all motors to positions in units", cmdMovetounitAll},
+  {"moveunit", "mf", "moveunit <motor> <unit> - Move motor by units", cmdMoveunit},
+  {"moveunit_all", "F", "moveunit_all <unit0> ... <unitN> - Move all motors by units at once", cmdMoveunitAll},
+  {"platform", "mff", "platform <motor> <x> <y> - Set platform attachment point in units", cmdPlatform},
+  {"pose", "fff", "pose <roll> <pitch> <heave> - Move platform to orientation in degrees", cmdPose},
+  {"poseq", "fffff", "poseq <w> <x> <y> <z> <heave> - Move platform to quaternion orientation", cmdPoseq},
+  {"pvt", "lP", "pvt <ms> <pos0> <vel0> ... <posN> <velN> - Stream a timed waypoint", cmdPvt},
+  {"queue", "A", "queue <pos0> ... <posN> - Queue a coordinated move for all motors", cmdQueue},
+  {"quiet", "b", "quiet <0|1> - Disable echo and confirmations for machine control", cmdQuiet},
+  {"ramps", "", "ramps - Show acceleration ramp tables and their memory use", cmdRamps},
+  {"resume", "", "resume - Resume after emergency stop", cmdResume},
+  {"set_steps_per_unit", "mf", "set_steps_per_unit <motor> <factor> - Set steps per unit conversion factor", cmdSetStepsPerUnit},
+  {"speed", "mf", "speed <motor> <speed> - Set maximum speed", cmdSpeed},
+  {"stats", "", "stats - Show loop timing, step and overflow counters", cmdStats},
+  {"stats_reset", "", "stats_reset - Clear the runtime counters", cmdStatsReset},
+  {"status", "", "status - Show motor status", cmdStatus},
+  {"stop", "m", "stop <motor> - Stop specific motor", cmdStop},
+  {"stop_all", "", "stop_all - Stop all motors", cmdStopAll},
+  {"telemetry", "l", "telemetry <ms> - Push binary position frames every <ms> (0 = off)", cmdTelemetry}
+};
+
+static const uint8_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+int8_t findCommand(const char* name) {
+  int8_t low = 0;
+  int8_t high = COMMAND_COUNT - 1;
+  
+  while (low <= high) {
+    int8_t middle = (low + high) / 2;
+    int result = strcmp_P(name, COMMANDS[middle].name);
+    
+    if (result == 0) return middle;
+    if (result < 0) {
+      high = middle - 1;
+    }
+    else {
+      low = middle + 1;
+    }
+  }
+  
+  return -1;
+}
+
+void readCommandSchema(uint8_t index, char* schema) {
+  strncpy_P(schema, COMMANDS[index].schema, COMMAND_SCHEMA_SIZE);
+}
+
+CommandHandler readCommandHandler(uint8_t index) {
+  return (CommandHandler)pgm_read_ptr(&COMMANDS[index].handler);
+}
+
+// Absolute targets may be overwritten by newer ones and an emergency stop
+// discards them; every other command applies the pending target first
+bool isMailboxBarrier(uint8_t index) {
+  CommandHandler handler = readCommandHandler(index);
+  return handler != cmdMoveto && handler != cmdMovetounit && handler != cmdMovetoAll &&
+         handler != cmdMovetounitAll && handler != cmdPose && handler != cmdPoseq &&
+         handler != cmdEmergencyStop;
+}
+
+void printCommandHelp(Print& out) {
+  for (uint8_t i = 0; i < COMMAND_COUNT; i++) {
+    out.println((const __FlashStringHelper*)COMMANDS[i].help);
+  }
+}
+
+void printCommandUsage(Print& out, uint8_t index) {
+  out.print(F("Usage: "));
+  out.println((const __FlashStringHelper*)COMMANDS[index].help);
+}
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "../inc/ConfigStore.hpp"
+#include "../inc/BinaryProtocol.hpp"
+#include <EEPROM.h>
+
+#define CONFIG_MAGIC 0x5343
+
+static_assert(CONFIG_EEPROM_BASE + CONFIG_SLOTS * sizeof(ConfigRecord) <= E2END + 1, "Configuration slots do not fit in EEPROM");
+
+static uint16_t recordCrc(const uint8_t* data, uint16_t length) {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < length; i++) {
+    crc = BinaryProtocol::crc16(crc, data[i]);
+  }
+  return crc;
+}
+
+// Unset limits are LONG_MIN/LONG_MAX, which only fit 32 bits on AVR
+static int32_t storedPosition(long position) {
+  if (position > INT32_MAX) return INT32_MAX;
+  if (position < INT32_MIN) return INT32_MIN;
+  return position;
+}
+
+static int slotAddress(uint8_t slot) {
+  return CONFIG_EEPROM_BASE + slot * sizeof(ConfigRecord);
+}
+
+ConfigStore::ConfigStore() {
+  _motors = NULL;
+  _motorCount = 0;
+  _enabled = false;
+  _saveRequested = false;
+  _writing = false;
+  _slot = CONFIG_SLOTS - 1;
+  _sequence = 0;
+  _saves = 0;
+  _savedHash = 0;
+  _pendingHash = 0;
+  _changedAt = 0;
+  _lastCheck = 0;
+  _writeIndex = 0;
+}
+
+void ConfigStore::begin(Motor* motors, uint8_t motorCount) {
+  _motors = motors;
+  _motorCount = motorCount;
+}
+
+// Fills the record from the motors and returns a hash of the settings alone
+uint16_t ConfigStore::capture() {
+  memset(&_record, 0, sizeof(_record));
+  _record.magic = CONFIG_MAGIC;
+  _record.version = CONFIG_VERSION;
+  _record.motorCount = _motorCount;
+  
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    Motor& motor = _motors[i];
+    MotorConfig& config = _record.motors[i];
+    
+    config.homePosition = storedPosition(motor.getHomePosition());
+    config.minPosition = storedPosition(motor.getMinPosition());
+    config.maxPosition = storedPosition(motor.getMaxPosition());
+    config.stepsPerUnit = motor.getStepsPerUnit();
+    config.maxSpeed = motor.getMaxSpeed();
+    config.acceleration = motor.getAcceleration();
+    config.jerk = motor.getJerk();
+    config.flags = (motor.isDirectionInverted() ? CONFIG_INVERTED : 0) |
+                   (motor.isLimitActive() ? CONFIG_LIMITS : 0) |
+                   (motor.isCalibrated() ? CONFIG_CALIBRATED : 0);
+  }
+  
+  return recordCrc((const uint8_t*)_record.motors, sizeof(_record.motors));
+}
+
+void ConfigStore::apply() {
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    Motor& motor = _motors[i];
+    MotorConfig& config = _record.motors[i];
+    
+    motor.setStepsPerUnit(config.stepsPerUnit);
+    motor.setMaxSpeed(config.maxSpeed);
+    motor.setAcceleration(config.acceleration);
+    motor.setJerk(config.jerk);
+    motor.invertDirection(config.flags & CONFIG_INVERTED);
+    motor.setHomePosition(config.homePosition);
+    motor.setLimits(config.minPosition, config.maxPosition, config.flags & CONFIG_LIMITS);
+    motor.setCalibrated(config.flags & CONFIG_CALIBRATED);
+  }
+}
+
+bool ConfigStore::readSlot(uint8_t slot) {
+  uint8_t* data = (uint8_t*)&_record;
+  int address = slotAddress(slot);
+  
+  for (uint16_t i = 0; i < sizeof(_record); i++) {
+    data[i] = EEPROM.read(address + i);
+  }
+  
+  return _record.magic == CONFIG_MAGIC &&
+         _record.version == CONFIG_VERSION &&
+         _record.motorCount == _motorCount &&
+         _record.crc == recordCrc(data, offsetof(ConfigRecord, crc));
+}
+
+bool ConfigStore::load() {
+  bool found = false;
+  uint8_t newest = 0;
+  uint16_t newestSequence = 0;
+  
+  for (uint8_t slot = 0; slot < CONFIG_SLOTS; slot++) {
+    if (!readSlot(slot)) continue;
+    
+    if (!found || (int16_t)(_record.sequence - newestSequence) > 0) {
+      found = true;
+      newest = slot;
+      newestSequence = _record.sequence;
+    }
+  }
+  
+  _enabled = true;
+  _writing = false;
+  _saveRequested = false;
+  
+  if (found) {
+    readSlot(newest);
+    apply();
+    _slot = newest;
+    _sequence = newestSequence;
+  }
+  
+  // Whatever is in effect now counts as saved
+  _savedHash = capture();
+  _pendingHash = _savedHash;
+  return found;
+}
+
+// Skips the settle delay; the write still goes out a byte at a time
+void ConfigStore::save() {
+  _enabled = true;
+  _saveRequested = true;
+}
+
+// Settings are only compared while the motors are idle, since capturing the
+// record costs more than a step interval on AVR
+void ConfigStore::update(bool idle) {
+  if (!_enabled) return;
+  
+  if (_writing) {
+    writeNext();
+    return;
+  }
+  
+  unsigned long now = millis();
+  if (!_saveRequested && (!idle || now - _lastCheck < CONFIG_CHECK_INTERVAL_MS)) return;
+  _lastCheck = now;
+  
+  uint16_t hash = capture();
+  if (hash == _savedHash) {
+    _saveRequested = false;
+    _pendingHash = hash;
+    return;
+  }
+  
+  if (hash != _pendingHash) {
+    _pendingHash = hash;
+    _changedAt = now;
+  }
+  
+  if (_saveRequested || now - _changedAt >= CONFIG_SAVE_DELAY_MS) {
+    _record.sequence = _sequence + 1;
+    _record.crc = recordCrc((const uint8_t*)&_record, offsetof(ConfigRecord, crc));
+    _slot = (_slot + 1) % CONFIG_SLOTS;
+    _writeIndex = 0;
+    _writing = true;
+    _saveRequested = false;
+  }
+}
+
+// Unchanged bytes are skipped; at most one byte is programmed per call
+void ConfigStore::writeNext() {
+  const uint8_t* data = (const uint8_t*)&_record;
+  int address = slotAddress(_slot);
+  
+  while (_writeIndex < sizeof(_record) && eeprom_is_ready()) {
+    uint8_t value = data[_writeIndex];
+    bool changed = EEPROM.read(address + _writeIndex) != value;
+    
+    if (changed) {
+      EEPROM.write(address + _writeIndex, value);
+    }
+    _writeIndex++;
+    
+    if (changed) return;
+  }
+  
+  if (_writeIndex >= sizeof(_record)) {
+    _writing = false;
+    _sequence = _record.sequence;
+    _savedHash = recordCrc((const uint8_t*)_record.motors, sizeof(_record.motors));
+    _saves++;
+  }
+}
+
+bool ConfigStore::isPending() {
+  return _writing || _saveRequested || _pendingHash != _savedHash;
+}
+
+uint8_t ConfigStore::getSlot() {
+  return _slot;
+}
+
+uint16_t ConfigStore::getSequence() {
+  return _sequence;
+}
+
+uint16_t ConfigStore::getSaves() {
+  return _saves;
+}
+
+void ConfigStore::print(Print& out) {
+  out.println(F("-- Config --"));
+  out.print(F("Slot: "));
+  out.print(_slot);
+  out.print(F(" of "));
+  out.println(CONFIG_SLOTS);
+  out.print(F("Sequence: "));
+  out.println(_sequence);
+  out.print(F("Saves: "));
+  out.println(_saves);
+  out.print(F("Record: "));
+  out.print(sizeof(ConfigRecord));
+  out.println(F(" bytes"));
+  out.print(F("State: "));
+  if (!_enabled) {
+    out.println(F("not loaded"));
+  }
+  else if (_writing) {
+    out.println(F("writing"));
+  }
+  else if (isPending()) {
+    out.println(F("pending"));
+  }
+  else {
+    out.println(F("saved"));
+  }
+}
@@ -0,0 +1,261 @@
+#include "../inc/CoordinatedMove.hpp"
+#include "../inc/MotionPlanner.hpp"
+
+CoordinatedMove::CoordinatedMove() {
+  _motors = NULL;
+  _axisCount = 0;
+  _axisMask = 0;
+  _active = false;
+  _timerDriven = false;
+  _totalSteps = 0;
+  _completedSteps = 0;
+  _stopAt = 0;
+  _pathRatio = 1.0;
+  _exitSpeed = 0;
+  _retargetPending = false;
+  _retargetSpeed = 0;
+  _lastStepTime = 0;
+  _stepSpeed = 0;
+  _stepInterval = 0;
+  _lastUpdateTime = 0;
+}
+
+bool CoordinatedMove::start(Motor* motors, uint8_t axisCount, const long targets[], float entrySpeed, float exitSpeed) {
+  if (_active) {
+    release();
+  }
+  
+  _motors = motors;
+  _axisCount = axisCount;
+  _axisMask = 0;
+  _totalSteps = 0;
+  _completedSteps = 0;
+  _timerDriven = false;
+  _retargetPending = false;
+  
+  long limited[MAX_MOTORS];
+  float length = 0.0;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    limited[i] = _motors[i].limitPosition(targets[i]);
+    _delta[i] = limited[i] - _motors[i].getCurrentPosition();
+    
+    if (_delta[i] != 0) {
+      _axisMask |= (1 << i);
+      _timerDriven = _motors[i].isTimerDriven();
+    }
+    length += (float)_delta[i] * _delta[i];
+    if (labs(_delta[i]) > _totalSteps) {
+      _totalSteps = labs(_delta[i]);
+    }
+  }
+  
+  if (_totalSteps == 0) {
+    _profile.reset();
+    return false;
+  }
+  
+  _stopAt = _totalSteps;
+  _pathRatio = _totalSteps / sqrt(length);
+  _exitSpeed = floatToFixed(exitSpeed * _pathRatio);
+  
+  float maxSpeed = 0.0;
+  float acceleration = 0.0;
+  float jerk = 0.0;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    if (!(_axisMask & (1 << i))) continue;
+    
+    float scale = (float)_totalSteps / labs(_delta[i]);
+    float axisSpeed = _motors[i].getMaxSpeed() * scale;
+    float axisAccel = _motors[i].getAcceleration() * scale;
+    float axisJerk = _motors[i].getJerk() * scale;
+    
+    if (maxSpeed == 0.0 || axisSpeed < maxSpeed) maxSpeed = axisSpeed;
+    if (acceleration == 0.0 || axisAccel < acceleration) acceleration = axisAccel;
+    if (axisJerk > 0.0 && (jerk == 0.0 || axisJerk < jerk)) jerk = axisJerk;
+    
+    _error[i] = _totalSteps >> 1;
+    _motors[i].beginExternal(limited[i]);
+  }
+  
+  _profile.setMaxSpeed(maxSpeed);
+  _profile.setAcceleration(acceleration);
+  _profile.setJerk(jerk);
+  _profile.reset(min(entrySpeed * _pathRatio, maxSpeed));
+  
+  if (_timerDriven) {
+    long deltas[MAX_MOTORS];
+    uint8_t channelMask = 0;
+    
+    for (uint8_t i = 0; i < _axisCount; i++) {
+      uint8_t channel = _motors[i].getTimerChannel();
+      if (!(_axisMask & (1 << i)) || channel == 0xFF) continue;
+      
+      deltas[channel] = _delta[i];
+      channelMask |= (1 << channel);
+    }
+    stepTimer.beginGroup(channelMask, deltas, _totalSteps);
+  }
+  
+  _lastStepTime = micros();
+  _lastUpdateTime = _lastStepTime;
+  _active = true;
+  return true;
+}
+
+bool CoordinatedMove::retarget(Motor* motors, uint8_t axisCount, const long targets[]) {
+  if (!_active || axisCount != _axisCount) {
+    return start(motors, axisCount, targets);
+  }
+  
+  float pathSpeed = getPathSpeed();
+  float junction = junctionSpeed(targets);
+  
+  if (pathSpeed <= junction) {
+    return start(motors, axisCount, targets, pathSpeed);
+  }
+  
+  // End this move early, at the point where it has slowed to the junction speed
+  float speed = _profile.getSpeed();
+  float exit = junction * _pathRatio;
+  long brake = junction > 0.0 ? (long)((speed * speed - exit * exit) / (2.0 * _profile.getAcceleration())) + 1 : _profile.stoppingDistance();
+  
+  _stopAt = min(_totalSteps, _completedSteps + brake);
+  _retargetSpeed = floatToFixed(exit);
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _retarget[i] = targets[i];
+  }
+  _retargetPending = true;
+  return true;
+}
+
+// Path speed the turn onto the new targets allows, using the planner's junction deviation
+float CoordinatedMove::junctionSpeed(const long targets[]) {
+  float dot = 0.0;
+  float oldLength = 0.0;
+  float newLength = 0.0;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    float delta = _motors[i].limitPosition(targets[i]) - _motors[i].getCurrentPosition();
+    dot += delta * _delta[i];
+    oldLength += (float)_delta[i] * _delta[i];
+    newLength += delta * delta;
+  }
+  
+  if (oldLength == 0.0 || newLength == 0.0) return 0.0;
+  
+  return MotionPlanner::junctionSpeed(dot / sqrt(oldLength * newLength), _profile.getAcceleration() / _pathRatio, getPathSpeed());
+}
+
+void CoordinatedMove::stepAxes() {
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    if (!(_axisMask & (1 << i))) continue;
+    
+    _error[i] += labs(_delta[i]);
+    if (_error[i] >= _totalSteps) {
+      _error[i] -= _totalSteps;
+      _motors[i].step(_delta[i] < 0 ? -1 : 1);
+    }
+  }
+  _completedSteps++;
+}
+
+void CoordinatedMove::run() {
+  if (!_active) return;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    if ((_axisMask & (1 << i)) && !_motors[i].isExternallyDriven()) {
+      stop();
+      return;
+    }
+  }
+  
+  unsigned long now = micros();
+  unsigned long elapsed = now - _lastUpdateTime;
+  _lastUpdateTime = now;
+  
+  if (_timerDriven) {
+    _completedSteps = _totalSteps - stepTimer.getGroupRemaining();
+  }
+  
+  fixed_t exitSpeed = _retargetPending ? _retargetSpeed : _exitSpeed;
+#if FIXED_POINT_PROFILE
+  fixed_t speed = _profile.updateFixed(_stopAt - _completedSteps, elapsed, exitSpeed);
+#else
+  fixed_t speed = floatToFixed(_profile.update(_stopAt - _completedSteps, elapsed * 1.0e-6, fixedToFloat(exitSpeed)));
+#endif
+  
+  if (_timerDriven) {
+    stepTimer.setGroupRate(speed);
+  }
+  else if (speed > 0) {
+    // Microseconds per step from the speed in 1/256 steps/s, redone only when it changes
+    if (speed != _stepSpeed) {
+      _stepSpeed = speed;
+      _stepInterval = (speed >> 8) ? (1000000UL << 8) / ((uint32_t)speed >> 8) : 0xFFFFFFFFUL;
+    }
+    if (now - _lastStepTime >= _stepInterval) {
+      _lastStepTime = now;
+      stepAxes();
+    }
+  }
+  
+  if (_completedSteps >= _stopAt) {
+    release();
+    
+    if (_retargetPending) {
+      start(_motors, _axisCount, _retarget, fixedToFloat(_retargetSpeed) / _pathRatio);
+    }
+  }
+}
+
+void CoordinatedMove::release() {
+  if (_timerDriven) {
+    stepTimer.endGroup();
+  }
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    if (_axisMask & (1 << i)) {
+      _motors[i].endExternal();
+    }
+  }
+  
+  _active = false;
+}
+
+void CoordinatedMove::stop() {
+  if (_active) {
+    release();
+  }
+  _retargetPending = false;
+  _profile.reset();
+}
+
+void CoordinatedMove::setExitSpeed(float speed) {
+  _exitSpeed = floatToFixed(speed * _pathRatio);
+}
+
+bool CoordinatedMove::isActive() {
+  return _active;
+}
+
+bool CoordinatedMove::isRetargeting() {
+  return _active && _retargetPending;
+}
+
+float CoordinatedMove::getSpeed() {
+  return _profile.getSpeed();
+}
+
+float CoordinatedMove::getPathSpeed() {
+  return _profile.getSpeed() / _pathRatio;
+}
+
+long CoordinatedMove::getTotalSteps() {
+  return _totalSteps;
+}
+
+long CoordinatedMove::getRemainingSteps() {
+  return _active ? _stopAt - _completedSteps : 0;
+}
@@ -0,0 +1,83 @@
+#include "../inc/FixedPoint.hpp"
+
+static const int16_t SINE_TABLE[65] PROGMEM = {
+  0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+  6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+  12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+  23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+  27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+  32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+  32767
+};
+
+int16_t sinQ15(uint16_t angle) {
+  uint8_t quarter = angle >> 14;
+  uint16_t offset = angle & 0x3FFF;
+  
+  if (quarter & 1) {
+    offset = 0x4000 - offset;
+  }
+  
+  uint8_t index = offset >> 8;
+  uint8_t fraction = offset & 0xFF;
+  int16_t value = pgm_read_word(&SINE_TABLE[index]);
+  
+  if (fraction) {
+    int16_t next = pgm_read_word(&SINE_TABLE[index + 1]);
+    value += ((long)(next - value) * fraction) >> 8;
+  }
+  
+  return (quarter & 2) ? -value : value;
+}
+
+int16_t cosQ15(uint16_t angle) {
+  return sinQ15(angle + 0x4000);
+}
+
+uint16_t degreesToAngle(float degrees) {
+  return (uint16_t)(long)(degrees * (ANGLE_FULL_TURN / 360.0));
+}
+
+int16_t floatToQ14(float value) {
+  if (value > 1.99) value = 1.99;
+  if (value < -1.99) value = -1.99;
+  return (int16_t)(value * 16384.0);
+}
+
+fixed_t floatToFixed(float value) {
+  if (value >= 32767.0) return FIXED_MAX;
+  if (value <= -32767.0) return -FIXED_MAX;
+  return (fixed_t)(value * 65536.0);
+}
+
+float fixedToFloat(fixed_t value) {
+  return value * (1.0 / 65536.0);
+}
+
+fixed_t fixedMul(fixed_t a, fixed_t b) {
+  return (fixed_t)(((int64_t)a * b) >> 16);
+}
+
+uint32_t isqrt32(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  
+  while (bit > value) {
+    bit >>= 2;
+  }
+  
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  
+  return root;
+}
@@ -0,0 +1,136 @@
+#include "../inc/FixedProfile.hpp"
+
+FixedProfile::FixedProfile() {
+  _maxSpeed = FIXED_ONE;
+  _speed = 0;
+  _acceleration = 256;
+  _ramp = NULL;
+  updateLimits();
+}
+
+void FixedProfile::setMaxSpeed(float speed) {
+  _maxSpeed = floatToFixed(fabs(speed));
+  updateLimits();
+}
+
+void FixedProfile::setAcceleration(float accel) {
+  accel = fabs(accel);
+  _acceleration = accel >= 16777215.0 ? 16777215UL : (uint32_t)(accel * 256.0);
+  updateLimits();
+}
+
+// Jerk limiting needs roots and cube roots that have no cheap integer form
+bool FixedProfile::setJerk(float jerk) {
+  return jerk == 0.0;
+}
+
+void FixedProfile::updateLimits() {
+  // Speed gained per microsecond, scaled by 2^16 on top of the Q16.16 speed
+  _rampRate = (_acceleration >> 8) >= 1000000UL ? 0xFFFFFFFFUL : (uint32_t)(_acceleration * 16.777216);
+  
+  uint32_t maxSpeed = (_maxSpeed >> 16) + 1;
+  uint32_t accel = _acceleration >> 8;
+  _cruiseDistance = accel ? (maxSpeed * maxSpeed) / (2 * accel) + 1 : 0;
+}
+
+void FixedProfile::setRampTable(RampTable* table) {
+  _ramp = table;
+}
+
+void FixedProfile::reset(float speed) {
+  _speed = floatToFixed(speed);
+}
+
+void FixedProfile::resetFixed(fixed_t speed) {
+  _speed = speed;
+}
+
+float FixedProfile::update(long distanceToGo, float dt, float exitSpeed) {
+  return fixedToFloat(updateFixed(distanceToGo, (unsigned long)(dt * 1.0e6), floatToFixed(exitSpeed)));
+}
+
+fixed_t FixedProfile::targetSpeed(long distanceToGo, fixed_t exitSpeed) {
+  if (distanceToGo == 0 || (_speed > 0 && distanceToGo < 0) || (_speed < 0 && distanceToGo > 0)) {
+    return 0;
+  }
+  
+  fixed_t target = _maxSpeed;
+  uint32_t distance = labs(distanceToGo);
+  uint32_t accel = _acceleration >> 8;
+  
+  if (accel && exitSpeed == 0 && _ramp && _ramp->isValid()) {
+    fixed_t limited = _ramp->speedAt(distance);
+    if (limited < target) target = limited;
+  }
+  else if (accel && distance < _cruiseDistance) {
+    uint32_t exit = (uint32_t)labs(exitSpeed) >> 16;
+    uint32_t speedSquared = exit * exit + 2 * accel * distance;
+    fixed_t limited;
+    
+    // Small speeds keep five fractional bits through the root
+    if (speedSquared < (1UL << 21)) {
+      limited = (fixed_t)isqrt32(speedSquared << 10) << 11;
+    }
+    else {
+      limited = (fixed_t)isqrt32(speedSquared) << 16;
+    }
+    
+    if (limited < target) target = limited;
+  }
+  
+  return distanceToGo < 0 ? -target : target;
+}
+
+fixed_t FixedProfile::updateFixed(long distanceToGo, unsigned long dtMicros, fixed_t exitSpeed) {
+  fixed_t target = targetSpeed(distanceToGo, exitSpeed);
+  
+  if (_acceleration == 0) {
+    _speed = target;
+    return _speed;
+  }
+  
+  // A stalled loop still gains only a * dt; the comparisons below stop at the target
+  uint64_t gain = ((uint64_t)_rampRate * dtMicros) >> 16;
+  uint32_t step = gain > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)gain;
+  
+  if (target > _speed) {
+    _speed = (uint32_t)target - (uint32_t)_speed > step ? (fixed_t)((uint32_t)_speed + step) : target;
+  }
+  else if (target < _speed) {
+    _speed = (uint32_t)_speed - (uint32_t)target > step ? (fixed_t)((uint32_t)_speed - step) : target;
+  }
+  
+  if (target != 0 && labs(target) < labs(_speed)) {
+    _speed = target;
+  }
+  
+  return _speed;
+}
+
+float FixedProfile::getSpeed() {
+  return fixedToFloat(_speed);
+}
+
+fixed_t FixedProfile::getSpeedFixed() {
+  return _speed;
+}
+
+float FixedProfile::getMaxSpeed() {
+  return fixedToFloat(_maxSpeed);
+}
+
+float FixedProfile::getAcceleration() {
+  return _acceleration / 256.0;
+}
+
+float FixedProfile::getJerk() {
+  return 0.0;
+}
+
+long FixedProfile::stoppingDistance() {
+  uint32_t accel = _acceleration >> 8;
+  if (!accel) return 0;
+  
+  uint32_t speed = (uint32_t)labs(_speed) >> 16;
+  return (long)((speed * speed) / (2 * accel)) + 1;
+}
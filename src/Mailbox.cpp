@@ -0,0 +1,67 @@
+#include "../inc/Mailbox.hpp"
+
+Mailbox::Mailbox() {
+  _enabled = false;
+  _appliedAt = 0;
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+    _targets[i] = 0;
+  }
+  clear();
+}
+
+void Mailbox::setEnabled(bool enabled) {
+  _enabled = enabled;
+}
+
+bool Mailbox::isEnabled() {
+  return _enabled;
+}
+
+uint8_t Mailbox::post(uint8_t kind, uint8_t mask, const long targets[], unsigned long now) {
+  uint8_t replaced = 0;
+  
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+    if (!(mask & (1 << i))) continue;
+    
+    if (_mask & (1 << i)) replaced++;
+    _targets[i] = targets[i];
+  }
+  
+  _kind = kind;
+  _mask |= mask;
+  _postedAt = now;
+  return replaced;
+}
+
+void Mailbox::clear() {
+  _kind = MAILBOX_EMPTY;
+  _mask = 0;
+  _postedAt = 0;
+}
+
+bool Mailbox::isEmpty() {
+  return _kind == MAILBOX_EMPTY;
+}
+
+bool Mailbox::isDue(unsigned long now) {
+  return _kind != MAILBOX_EMPTY && now - _appliedAt >= MAILBOX_INTERVAL_US;
+}
+
+uint8_t Mailbox::getKind() {
+  return _kind;
+}
+
+uint8_t Mailbox::getMask() {
+  return _mask;
+}
+
+long Mailbox::getTarget(uint8_t motor) {
+  return motor < MAX_MOTORS ? _targets[motor] : 0;
+}
+
+unsigned long Mailbox::take(unsigned long now) {
+  unsigned long age = now - _postedAt;
+  _appliedAt = now;
+  clear();
+  return age;
+}
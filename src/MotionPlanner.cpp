@@ -0,0 +1,165 @@
+#include "../inc/MotionPlanner.hpp"
+
+MotionPlanner::MotionPlanner() {
+  _head = 0;
+  _count = 0;
+  _motors = NULL;
+  _axisCount = 0;
+  _previousNominal = 0.0;
+  _hasPrevious = false;
+}
+
+void MotionPlanner::begin(Motor* motors, uint8_t axisCount) {
+  _motors = motors;
+  _axisCount = axisCount > PLANNER_AXES ? PLANNER_AXES : axisCount;
+  clear();
+}
+
+uint8_t MotionPlanner::indexOf(uint8_t offset) {
+  return (_head + offset) % PLANNER_QUEUE_SIZE;
+}
+
+void MotionPlanner::sync() {
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _position[i] = _motors[i].getTargetPosition();
+    _previousUnit[i] = 0.0;
+  }
+  _hasPrevious = false;
+}
+
+bool MotionPlanner::push(const long targets[]) {
+  if (isFull() || !_motors) {
+    return false;
+  }
+  
+  PlannerSegment& segment = _segments[indexOf(_count)];
+  long delta[PLANNER_AXES];
+  float length = 0.0;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    segment.target[i] = _motors[i].limitPosition(targets[i]);
+    delta[i] = segment.target[i] - _position[i];
+    length += (float)delta[i] * delta[i];
+  }
+  
+  if (length == 0.0) {
+    return true;
+  }
+  
+  length = sqrt(length);
+  segment.length = length;
+  segment.nominalSpeed = 0.0;
+  segment.acceleration = 0.0;
+  
+  float unit[PLANNER_AXES];
+  float dot = 0.0;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    unit[i] = delta[i] / length;
+    dot += unit[i] * _previousUnit[i];
+    
+    if (delta[i] == 0) continue;
+    
+    float scale = length / labs(delta[i]);
+    float axisSpeed = _motors[i].getMaxSpeed() * scale;
+    float axisAccel = _motors[i].getAcceleration() * scale;
+    
+    if (segment.nominalSpeed == 0.0 || axisSpeed < segment.nominalSpeed) segment.nominalSpeed = axisSpeed;
+    if (segment.acceleration == 0.0 || axisAccel < segment.acceleration) segment.acceleration = axisAccel;
+  }
+  
+  segment.maxEntrySpeed = 0.0;
+  
+  if (_hasPrevious) {
+    segment.maxEntrySpeed = junctionSpeed(dot, segment.acceleration, min(segment.nominalSpeed, _previousNominal));
+  }
+  
+  segment.entrySpeed = segment.maxEntrySpeed;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _position[i] = segment.target[i];
+    _previousUnit[i] = unit[i];
+  }
+  _previousNominal = segment.nominalSpeed;
+  _hasPrevious = true;
+  _count++;
+  
+  recalculate();
+  return true;
+}
+
+// cosTheta is the angle between the old direction reversed and the new one,
+// so it is -1 straight on and 1 for a full reversal
+float MotionPlanner::junctionSpeed(float dot, float acceleration, float limit) {
+  float cosTheta = -dot;
+  if (cosTheta < -0.999) return limit;
+  if (cosTheta > 0.999) return 0.0;
+  
+  float sinHalf = sqrt(0.5 * (1.0 - cosTheta));
+  return min(limit, (float)sqrt(acceleration * PLANNER_JUNCTION_DEVIATION * sinHalf / (1.0 - sinHalf)));
+}
+
+void MotionPlanner::recalculate() {
+  if (_count == 0) return;
+  
+  float nextEntry = 0.0;
+  
+  for (int8_t i = _count - 1; i >= 0; i--) {
+    PlannerSegment& segment = _segments[indexOf(i)];
+    float reachable = sqrt(nextEntry * nextEntry + 2.0 * segment.acceleration * segment.length);
+    segment.entrySpeed = min(segment.maxEntrySpeed, reachable);
+    nextEntry = segment.entrySpeed;
+  }
+  
+  for (uint8_t i = 0; i + 1 < _count; i++) {
+    PlannerSegment& segment = _segments[indexOf(i)];
+    PlannerSegment& next = _segments[indexOf(i + 1)];
+    float reachable = sqrt(segment.entrySpeed * segment.entrySpeed + 2.0 * segment.acceleration * segment.length);
+    if (next.entrySpeed > reachable) {
+      next.entrySpeed = reachable;
+    }
+  }
+}
+
+PlannerSegment* MotionPlanner::peek() {
+  return _count > 0 ? &_segments[_head] : NULL;
+}
+
+void MotionPlanner::pop() {
+  if (_count == 0) return;
+  
+  _head = indexOf(1);
+  _count--;
+}
+
+void MotionPlanner::clear() {
+  _head = 0;
+  _count = 0;
+  if (_motors) {
+    sync();
+  }
+}
+
+bool MotionPlanner::isEmpty() {
+  return _count == 0;
+}
+
+bool MotionPlanner::isFull() {
+  return _count >= PLANNER_QUEUE_SIZE;
+}
+
+uint8_t MotionPlanner::getCount() {
+  return _count;
+}
+
+uint8_t MotionPlanner::getFree() {
+  return PLANNER_QUEUE_SIZE - _count;
+}
+
+uint8_t MotionPlanner::getAxisCount() {
+  return _axisCount;
+}
+
+float MotionPlanner::getExitSpeed() {
+  return _count > 0 ? _segments[_head].entrySpeed : 0.0;
+}
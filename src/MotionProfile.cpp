@@ -0,0 +1,196 @@
+#include "../inc/MotionProfile.hpp"
+
+MotionProfile::MotionProfile() {
+  _maxSpeed = 1.0;
+  _acceleration = 1.0;
+  _speed = 0.0;
+  _ramp = NULL;
+  _jerk = 0.0;
+  reset();
+}
+
+void MotionProfile::setMaxSpeed(float speed) {
+  _maxSpeed = fabs(speed);
+}
+
+void MotionProfile::setAcceleration(float accel) {
+  _acceleration = fabs(accel);
+  updateWindow();
+}
+
+bool MotionProfile::setJerk(float jerk) {
+  _jerk = fabs(jerk);
+  updateWindow();
+  return true;
+}
+
+// An S-curve is the trapezoid averaged over the time it takes to build full acceleration
+void MotionProfile::updateWindow() {
+  _window = (_jerk > 0.0 && _acceleration > 0.0) ? _acceleration / _jerk : 0.0;
+  reset(_speed);
+}
+
+void MotionProfile::setRampTable(RampTable* table) {
+  _ramp = table;
+}
+
+void MotionProfile::reset(float speed) {
+  _speed = speed;
+  _leadSpeed = speed;
+  _lead = 0.0;
+  _leadTrend = 0;
+  _settled = 0.0;
+  _slot = 0;
+  _slotSteps = 0.0;
+  _slotTime = 0.0;
+  
+  float slotWidth = _window / SCURVE_WINDOW_SLOTS;
+  for (uint8_t i = 0; i < SCURVE_WINDOW_SLOTS; i++) {
+    _history[i] = speed * slotWidth;
+  }
+  _historySum = speed * slotWidth * SCURVE_WINDOW_SLOTS;
+}
+
+float MotionProfile::ramp(float speed, long distanceToGo, float dt, float exitSpeed) {
+  float target = 0.0;
+  
+  if (distanceToGo != 0 && speed * distanceToGo >= 0) {
+    target = _maxSpeed;
+    if (_acceleration > 0.0) {
+      if (exitSpeed == 0.0 && _ramp && _ramp->isValid()) {
+        target = min(target, fixedToFloat(_ramp->speedAt(labs(distanceToGo))));
+      }
+      else {
+        target = min(target, (float)sqrt(exitSpeed * exitSpeed + 2.0 * _acceleration * labs(distanceToGo)));
+      }
+    }
+    if (distanceToGo < 0) target = -target;
+  }
+  
+  if (_acceleration <= 0.0) {
+    return target;
+  }
+  
+  float step = _acceleration * dt;
+  
+  if (target > speed) {
+    speed = min(target, speed + step);
+  }
+  else if (target < speed) {
+    speed = max(target, speed - step);
+  }
+  
+  if (target != 0.0 && fabs(target) < fabs(speed)) {
+    speed = target;
+  }
+  
+  return speed;
+}
+
+// Averaging turns each change in the lead's acceleration into a ramp of jerk
+// J, but a lead that goes straight from speeding up to braking changes it by
+// 2A. The lead instead holds its speed for a window in between, and plans to
+// brake that much earlier so the hold never runs it past the target.
+float MotionProfile::lead(long ahead, float dt, float exitSpeed) {
+  float hold = _window - _settled;
+  long reach = ahead;
+  
+  if (hold > 0.0 && _leadTrend != 0 && (_leadTrend > 0) == (ahead > 0)) {
+    long coast = (long)(fabs(_leadSpeed) * hold);
+    reach = ahead > 0 ? max(ahead - coast, 0L) : min(ahead + coast, 0L);
+  }
+  
+  float speed = ramp(_leadSpeed, reach, dt, exitSpeed);
+  
+  if (hold > 0.0 && (speed - _leadSpeed) * _leadTrend < 0.0) {
+    // Only braking for the real target may cut the hold short
+    float limit = ramp(_leadSpeed, ahead, dt, exitSpeed);
+    speed = fabs(limit) < fabs(_leadSpeed) ? limit : _leadSpeed;
+  }
+  
+  if (speed == _leadSpeed) {
+    if (_settled < _window) _settled += dt;
+  }
+  else {
+    _leadTrend = speed > _leadSpeed ? 1 : -1;
+    _settled = 0.0;
+  }
+  
+  return speed;
+}
+
+// Moving average of the lead trapezoid over the last _window seconds
+float MotionProfile::smooth(float dt) {
+  float slotWidth = _window / SCURVE_WINDOW_SLOTS;
+  
+  _slotSteps += _leadSpeed * dt;
+  _slotTime += dt;
+  
+  while (_slotTime >= slotWidth) {
+    _slotTime -= slotWidth;
+    _slot = (_slot + 1) % SCURVE_WINDOW_SLOTS;
+    _history[_slot] = _slotSteps;
+    _slotSteps = 0.0;
+    
+    _historySum = 0.0;
+    for (uint8_t i = 0; i < SCURVE_WINDOW_SLOTS; i++) {
+      _historySum += _history[i];
+    }
+  }
+  
+  // The oldest slot only partly overlaps the window
+  float oldest = _history[(_slot + 1) % SCURVE_WINDOW_SLOTS];
+  return (_historySum - oldest * (_slotTime / slotWidth) + _slotSteps) / _window;
+}
+
+float MotionProfile::update(long distanceToGo, float dt, float exitSpeed) {
+  if (_window <= 0.0) {
+    _speed = ramp(_speed, distanceToGo, dt, exitSpeed);
+    return _speed;
+  }
+  
+  // The lead trapezoid runs ahead of the motor by the steps the average has not released yet
+  long ahead = distanceToGo - (long)_lead;
+  
+  if (exitSpeed != 0.0 && distanceToGo != 0 && (ahead == 0 || (ahead > 0) != (distanceToGo > 0))) {
+    _leadSpeed = distanceToGo > 0 ? fabs(exitSpeed) : -fabs(exitSpeed);
+  }
+  else {
+    _leadSpeed = lead(ahead, dt, exitSpeed);
+  }
+  
+  _speed = smooth(dt);
+  _lead += (_leadSpeed - _speed) * dt;
+  
+  // Once the average has drained, any rounding left over is handed back to the trapezoid
+  if (_leadSpeed == 0.0 && _historySum == 0.0 && _slotSteps == 0.0) {
+    _speed = 0.0;
+    _lead = 0.0;
+  }
+  
+  return _speed;
+}
+
+float MotionProfile::getSpeed() {
+  return _speed;
+}
+
+float MotionProfile::getMaxSpeed() {
+  return _maxSpeed;
+}
+
+float MotionProfile::getAcceleration() {
+  return _acceleration;
+}
+
+float MotionProfile::getJerk() {
+  return _jerk;
+}
+
+long MotionProfile::stoppingDistance() {
+  if (_acceleration <= 0.0) return 0;
+  
+  // A lead still speeding up holds for the rest of its window before braking
+  float hold = _leadTrend != 0 && (_leadTrend > 0) == (_speed > 0) ? max(_window - _settled, 0.0f) : 0.0;
+  return (long)((_speed * _speed) / (2.0 * _acceleration) + fabs(_speed) * (_window * 0.5 + hold)) + 1;
+}
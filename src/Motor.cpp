@@ -2,7 +2,10 @@
 #include <limits.h>
 
 Motor::Motor() {
+  _index = 0;
+  _enablePin = 0xFF;
   _stepper = NULL;
+  _driver = NULL;
   _state = STOPPED;
   _enableInverted = false;
   _directionInverted = false;
@@ -10,24 +13,86 @@ Motor::Motor() {
   _maxPosition = LONG_MAX;
   _minPosition = LONG_MIN;
   _stepsPerUnit = 1.0;
+  _unitsPerStep = 1.0;
   _limitActive = false;
   _calibrated = false;
+  _external = false;
+  _jog = false;
+  _jogLatencyPending = false;
+  _jogSpeed = 0.0;
+  _jogTarget = 0.0;
+  _jogCommandTime = 0;
+  _jogStartTime = 0;
+  _jogStartPosition = 0;
+  _jogLatency = 0;
+  _positionShift = 0;
+  _timerChannel = 0xFF;
+  _limitPin = 0xFF;
+  _limitActiveLow = true;
+  _homingDirection = -1;
+  _homingPhase = HOMING_SEEK;
+  _homingFastSpeed = HOMING_FAST_SPEED;
+  _homingSlowSpeed = HOMING_SLOW_SPEED;
+  _homingBackoff = HOMING_BACKOFF_STEPS;
+  _homingMark = 0;
+  _homingStart = 0;
+  _targetPosition = 0;
+  _speed = 0.0;
+  _lastProfileUpdate = 0;
+  _lastStepTime = 0;
+  _activeMask = NULL;
+  _profile.setRampTable(&_ramp);
+}
+
+// Mirrors RUNNING/HOMING into the controller's active-motor bitmask
+void Motor::setActiveMask(uint8_t* mask) {
+  _activeMask = mask;
+}
+
+void Motor::setState(MotorState state) {
+  _state = state;
+  
+  if (_activeMask) {
+    if (state == RUNNING || state == HOMING) {
+      *_activeMask |= (1 << _index);
+    }
+    else {
+      *_activeMask &= ~(1 << _index);
+    }
+  }
+}
+
+MotorStorage* Motor::getStorage() {
+  return &_storage;
 }
 
-void Motor::init(uint8_t index, AccelStepper* stepper, uint8_t enablePin, bool enableInverted) {
+void Motor::init(uint8_t index, AccelStepper* stepper, PinDriver* driver, uint8_t enablePin, bool enableInverted) {
   _index = index;
   _stepper = stepper;
+  _driver = driver;
   _enablePin = enablePin;
   _enableInverted = enableInverted;
   
+  _driver->begin();
   if (_enablePin != 0xFF) {
-    pinMode(_enablePin, OUTPUT);
     disable();
   }
 }
 
+void Motor::attachTimer(uint8_t channel) {
+  _timerChannel = channel;
+  rebuildRamp();
+  
+  if (_timerChannel != 0xFF && _stepper) {
+    _targetPosition = _stepper->currentPosition();
+    stepTimer.setPosition(_timerChannel, _targetPosition);
+    stepTimer.setDirectionInverted(_timerChannel, _directionInverted);
+  }
+}
+
 void Motor::setStepsPerUnit(float stepsPerUnit) {
   _stepsPerUnit = stepsPerUnit;
+  _unitsPerStep = stepsPerUnit != 0.0 ? 1.0 / stepsPerUnit : 0.0;
 }
 
 void Motor::setLimits(long minPosition, long maxPosition, bool active) {
@@ -44,36 +109,57 @@ void Motor::invertDirection(bool inverted) {
   _directionInverted = inverted;
   if (_stepper) {
     _stepper->setPinsInverted(_directionInverted, false, false);
+    _driver->setDirectionInverted(_directionInverted);
+  }
+  if (_timerChannel != 0xFF) {
+    stepTimer.setDirectionInverted(_timerChannel, _directionInverted);
   }
 }
 
+// The switch sits at the home position, reached by travelling in <direction>
+void Motor::setLimitSwitch(uint8_t pin, int8_t direction, bool activeLow) {
+  _limitPin = pin;
+  _homingDirection = direction < 0 ? -1 : 1;
+  _limitActiveLow = activeLow;
+  
+  if (_limitPin != 0xFF) {
+    pinMode(_limitPin, activeLow ? INPUT_PULLUP : INPUT);
+  }
+}
+
+void Motor::setHomingSpeeds(float fastSpeed, float slowSpeed, long backoffSteps) {
+  _homingFastSpeed = fabs(fastSpeed);
+  _homingSlowSpeed = fabs(slowSpeed);
+  _homingBackoff = labs(backoffSteps);
+}
+
 void Motor::calibrateHome() {
   if (_stepper) {
-    _homePosition = _stepper->currentPosition();
-    Serial.print(F("Motor "));
-    Serial.print(_index);
-    Serial.print(F(" home position calibrated to: "));
-    Serial.println(_homePosition);
+    _homePosition = getCurrentPosition();
+    Verbose.print(F("Motor "));
+    Verbose.print(_index);
+    Verbose.print(F(" home position calibrated to: "));
+    Verbose.println(_homePosition);
   }
 }
 
 void Motor::calibrateMin() {
   if (_stepper) {
-    _minPosition = _stepper->currentPosition();
-    Serial.print(F("Motor "));
-    Serial.print(_index);
-    Serial.print(F(" min position calibrated to: "));
-    Serial.println(_minPosition);
+    _minPosition = getCurrentPosition();
+    Verbose.print(F("Motor "));
+    Verbose.print(_index);
+    Verbose.print(F(" min position calibrated to: "));
+    Verbose.println(_minPosition);
   }
 }
 
 void Motor::calibrateMax() {
   if (_stepper) {
-    _maxPosition = _stepper->currentPosition();
-    Serial.print(F("Motor "));
-    Serial.print(_index);
-    Serial.print(F(" max position calibrated to: "));
-    Serial.println(_maxPosition);
+    _maxPosition = getCurrentPosition();
+    Verbose.print(F("Motor "));
+    Verbose.print(_index);
+    Verbose.print(F(" max position calibrated to: "));
+    Verbose.println(_maxPosition);
     
     _calibrated = true;
     _limitActive = true;
@@ -84,9 +170,13 @@ bool Motor::isCalibrated() {
   return _calibrated;
 }
 
+void Motor::setCalibrated(bool calibrated) {
+  _calibrated = calibrated;
+}
+
 void Motor::enable(bool enabled) {
   if (_enablePin != 0xFF) {
-    digitalWrite(_enablePin, enabled ? !_enableInverted : _enableInverted);
+    _driver->writeEnable(enabled != _enableInverted);
   }
 }
 
@@ -98,121 +188,570 @@ void Motor::setMaxSpeed(float speed) {
   if (_stepper) {
     _stepper->setMaxSpeed(speed);
   }
+  _profile.setMaxSpeed(speed);
+  rebuildRamp();
 }
 
 void Motor::setAcceleration(float accel) {
   if (_stepper) {
     _stepper->setAcceleration(accel);
   }
+  _profile.setAcceleration(accel);
+  rebuildRamp();
+}
+
+bool Motor::setJerk(float jerk) {
+  if (!_profile.setJerk(jerk)) return false;
+  rebuildRamp();
+  return true;
+}
+
+// Only the timer and S-curve paths step through _profile; the polled
+// AccelStepper path and coordinated moves never read the table
+void Motor::rebuildRamp() {
+  if (_timerChannel != 0xFF || _profile.getJerk() > 0.0) {
+    _ramp.build(_profile.getMaxSpeed(), _profile.getAcceleration());
+  }
+  else {
+    _ramp.clear();
+  }
 }
 
 void Motor::setSpeed(float speed) {
   if (_stepper) {
     _stepper->setSpeed(speed);
   }
+  _speed = speed;
 }
 
-void Motor::moveTo(long position) {
+// Targets past a limit are pulled in to it; false reports that this happened
+bool Motor::moveTo(long position) {
+  long limited = limitPosition(position);
+  
   if (_stepper) {
-    if (_limitActive) {
-      if (position > _maxPosition) position = _maxPosition;
-      if (position < _minPosition) position = _minPosition;
+    _external = false;
+    _jog = false;
+    
+    if (_state != RUNNING) {
+      _profile.reset();
+      _lastProfileUpdate = micros();
     }
     
-    _stepper->moveTo(position);
-    _state = RUNNING;
+    if (_timerChannel != 0xFF) {
+      _targetPosition = limited;
+    }
+    else {
+      _stepper->moveTo(limited);
+    }
+    setState(RUNNING);
     enable();
   }
+  return limited == position;
 }
 
-void Motor::moveToUnit(float position) {
-  moveTo(long(position * _stepsPerUnit));
+bool Motor::moveToUnit(float position) {
+  return moveTo(long(position * _stepsPerUnit));
 }
 
-void Motor::move(long relativeSteps) {
-  if (_stepper) {
-    long newPosition = _stepper->currentPosition() + relativeSteps;
-    
-    if (_limitActive) {
-      if (newPosition > _maxPosition || newPosition < _minPosition) {
-        return;
-      }
-    }
-    
-    _stepper->move(relativeSteps);
-    _state = RUNNING;
-    enable();
+bool Motor::move(long relativeSteps) {
+  if (!_stepper) return true;
+  
+  long newPosition = getCurrentPosition() + relativeSteps;
+  
+  if (_timerChannel != 0xFF || _profile.getJerk() > 0.0 || limitPosition(newPosition) != newPosition) {
+    return moveTo(newPosition);
   }
+  
+  _external = false;
+  _jog = false;
+  _stepper->move(relativeSteps);
+  setState(RUNNING);
+  enable();
+  return true;
 }
 
-void Motor::moveUnit(float units) {
-  move(long(units * _stepsPerUnit));
+bool Motor::moveUnit(float units) {
+  return move(long(units * _stepsPerUnit));
 }
 
 void Motor::stop() {
   if (_stepper) {
-    _stepper->stop();
-    _state = STOPPED;
+    _external = false;
+    _jog = false;
+    if (_timerChannel != 0xFF) {
+      _targetPosition = stepTimer.getPosition(_timerChannel);
+      stepTimer.setMotion(_timerChannel, 0, _targetPosition);
+      _profile.reset();
+    }
+    else {
+      _stepper->stop();
+    }
+    setState(STOPPED);
   }
 }
 
+// Velocity mode has no target to brake for, so the limits are enforced here
 void Motor::runSpeed() {
   if (_stepper && _state == RUNNING) {
+    float speed = limitSpeed(_speed);
+    
+    if (_timerChannel != 0xFF) {
+      long stopAt = speed < 0.0 ? (_limitActive ? _minPosition : LONG_MIN) : (_limitActive ? _maxPosition : LONG_MAX);
+      stepTimer.setMotion(_timerChannel, floatToFixed(speed), stopAt);
+      return;
+    }
+    
+    _stepper->setSpeed(speed);
     _stepper->runSpeed();
   }
 }
 
+// Caps the speed to what can still stop at the limit ahead under the set acceleration
+float Motor::limitSpeed(float speed) {
+  if (!_limitActive || speed == 0.0) return speed;
+  
+  float room = speed > 0.0 ? (float)_maxPosition - getCurrentPosition() : getCurrentPosition() - (float)_minPosition;
+  if (room <= 0.0) return 0.0;
+  
+  float acceleration = getAcceleration();
+  if (speed * speed <= 2.0 * acceleration * room) return speed;
+  
+  float allowed = sqrt(2.0 * acceleration * room);
+  return speed > 0.0 ? allowed : -allowed;
+}
+
 void Motor::run() {
-  if (_stepper && _state == RUNNING) {
-    if (!_stepper->run()) {
-      if (_stepper->distanceToGo() == 0) {
-        _state = STOPPED;
-      }
+  if (_stepper && _state == HOMING) {
+    runHoming();
+    return;
+  }
+  
+  if (_stepper && _state == RUNNING && _jog) {
+    runJog();
+    return;
+  }
+  
+  if (_stepper && _state == RUNNING && !_external) {
+    if (_timerChannel != 0xFF) {
+      runTimed();
+      return;
+    }
+    
+    if (_profile.getJerk() > 0.0) {
+      runShaped();
+      return;
+    }
+    
+    long position = _stepper->currentPosition();
+    bool moving = _stepper->run();
+    
+    if (_stepper->currentPosition() != position) {
+      _lastStepTime = micros();
+    }
+    
+    if (!moving && _stepper->distanceToGo() == 0) {
+      setState(STOPPED);
+    }
+  }
+}
+
+// Polled S-curve: the profile sets the speed and AccelStepper only times the steps
+void Motor::runShaped() {
+  unsigned long now = micros();
+  float dt = (now - _lastProfileUpdate) * 1.0e-6;
+  _lastProfileUpdate = now;
+  
+  long distance = _stepper->distanceToGo();
+  float speed = _profile.update(distance, dt);
+  
+  if (distance == 0) {
+    _stepper->setSpeed(0.0);
+    _profile.reset();
+    setState(STOPPED);
+    return;
+  }
+  
+  _stepper->setSpeed(speed);
+  _stepper->runSpeed();
+}
+
+void Motor::runTimed() {
+  unsigned long now = micros();
+  unsigned long elapsed = now - _lastProfileUpdate;
+  _lastProfileUpdate = now;
+  
+  long position = stepTimer.getPosition(_timerChannel);
+  long distance = _targetPosition - position;
+#if FIXED_POINT_PROFILE
+  fixed_t speed = _profile.updateFixed(distance, elapsed);
+#else
+  fixed_t speed = floatToFixed(_profile.update(distance, elapsed * 1.0e-6));
+#endif
+  
+  if (speed == 0) {
+    stepTimer.setMotion(_timerChannel, 0, position);
+    if (distance == 0) {
+      setState(STOPPED);
     }
+    return;
   }
+  
+  long stopAt = _targetPosition;
+  if ((speed > 0) != (distance > 0)) {
+    long overshoot = _profile.stoppingDistance();
+    stopAt = speed > 0 ? position + overshoot : position - overshoot;
+  }
+  
+  stepTimer.setMotion(_timerChannel, speed, stopAt);
 }
 
+// Without a switch the motor simply returns to its stored home position
 void Motor::home() {
-  if (_stepper) {
-    _state = HOMING;
+  if (!_stepper) return;
+  
+  if (_limitPin == 0xFF) {
+    moveTo(_homePosition);
+    return;
+  }
+  
+  _external = false;
+  _jog = false;
+  _profile.reset();
+  _homingPhase = HOMING_SEEK;
+  _homingStart = millis();
+  setState(HOMING);
+  enable();
+}
+
+// Fast seek onto the switch, back off until it releases, then creep back onto it
+void Motor::runHoming() {
+  if (millis() - _homingStart > HOMING_TIMEOUT_MS) {
+    finishHoming(ERROR);
+    Output.print(F("Error: Motor "));
+    Output.print(_index);
+    Output.println(F(" homing timed out"));
+    return;
+  }
+  
+  bool triggered = isLimitTriggered();
+  
+  switch (_homingPhase) {
+    case HOMING_SEEK:
+      if (triggered) {
+        driveAt(0.0);
+        _homingMark = getCurrentPosition();
+        _homingPhase = HOMING_BACKOFF;
+        return;
+      }
+      driveAt(_homingDirection * _homingFastSpeed);
+      break;
+      
+    case HOMING_BACKOFF:
+      if (!triggered && labs(getCurrentPosition() - _homingMark) >= _homingBackoff) {
+        driveAt(0.0);
+        _homingPhase = HOMING_APPROACH;
+        return;
+      }
+      driveAt(-_homingDirection * _homingFastSpeed);
+      break;
+      
+    case HOMING_APPROACH:
+      if (triggered) {
+        finishHoming(STOPPED);
+        Verbose.print(F("Motor "));
+        Verbose.print(_index);
+        Verbose.println(F(" homed"));
+        return;
+      }
+      driveAt(_homingDirection * _homingSlowSpeed);
+      break;
+  }
+}
+
+void Motor::driveAt(float speed) {
+  if (_timerChannel != 0xFF) {
+    long position = stepTimer.getPosition(_timerChannel);
+    if (speed == 0.0) {
+      stepTimer.setMotion(_timerChannel, 0, position);
+    }
+    else {
+      stepTimer.setMotion(_timerChannel, floatToFixed(speed), speed < 0.0 ? LONG_MIN : LONG_MAX);
+    }
+    return;
+  }
+  
+  _stepper->setSpeed(speed);
+  if (speed != 0.0) {
+    _stepper->runSpeed();
+  }
+}
+
+// The switch position becomes the home position; a timeout leaves the count untouched
+void Motor::finishHoming(MotorState state) {
+  driveAt(0.0);
+  
+  if (state == STOPPED) {
+    _positionShift += _homePosition - getCurrentPosition();
+    if (_timerChannel != 0xFF) {
+      stepTimer.setPosition(_timerChannel, _homePosition);
+      _targetPosition = _homePosition;
+    }
+    else {
+      _stepper->setCurrentPosition(_homePosition);
+    }
+  }
+  else if (_timerChannel == 0xFF) {
+    _stepper->setCurrentPosition(_stepper->currentPosition());
+  }
+  setState(state);
+}
+
+// Velocity commands ramp under the acceleration limit and must keep arriving:
+// after JOG_TIMEOUT_MS without one the motor brakes to a stop
+void Motor::jog(float velocity) {
+  if (!_stepper) return;
+  
+  float limit = getMaxSpeed();
+  _jogTarget = constrain(velocity, -limit, limit);
+  _jogCommandTime = millis();
+  
+  if (_jog && _state == RUNNING) return;
+  
+  // Taking over from a move keeps its speed instead of stopping first. Timer-driven
+  // and S-curve moves are timed by the profile, so AccelStepper's speed is stale
+  _jogSpeed = 0.0;
+  if (_state == RUNNING && !_external) {
+    _jogSpeed = _timerChannel != 0xFF || _profile.getJerk() > 0.0 ? _profile.getSpeed() : getSpeed();
+  }
+  _external = false;
+  _jog = true;
+  _jogStartTime = micros();
+  _jogStartPosition = getCurrentPosition();
+  _jogLatencyPending = _jogTarget != 0.0;
+  _lastProfileUpdate = _jogStartTime;
+  setState(RUNNING);
+  enable();
+}
+
+void Motor::runJog() {
+  unsigned long now = micros();
+  
+  if (now - _lastProfileUpdate >= JOG_INTERVAL_US) {
+    float change = getAcceleration() * (now - _lastProfileUpdate) * 1.0e-6;
+    _lastProfileUpdate = now;
+    
+    if (millis() - _jogCommandTime > JOG_TIMEOUT_MS) {
+      _jogTarget = 0.0;
+    }
+    
+    if (_jogSpeed < _jogTarget) {
+      _jogSpeed = min(_jogSpeed + change, _jogTarget);
+    }
+    else {
+      _jogSpeed = max(_jogSpeed - change, _jogTarget);
+    }
+    
+    // Held at a limit the ramp restarts from rest rather than from a speed it never reached
+    _jogSpeed = limitSpeed(_jogSpeed);
     
-    _stepper->moveTo(_homePosition);
+    if (_jogSpeed == 0.0 && _jogTarget == 0.0) {
+      setSpeed(0.0);
+      runSpeed();
+      
+      // Velocity mode leaves AccelStepper's target behind; a later moveTo() to that
+      // same target would otherwise never start
+      if (_timerChannel == 0xFF) {
+        _stepper->setCurrentPosition(_stepper->currentPosition());
+      }
+      _jog = false;
+      _jogLatencyPending = false;
+      setState(STOPPED);
+      return;
+    }
+    setSpeed(_jogSpeed);
+  }
+  
+  runSpeed();
+  
+  if (_jogLatencyPending && getCurrentPosition() != _jogStartPosition) {
+    _jogLatencyPending = false;
+    _jogLatency = micros() - _jogStartTime;
+  }
+}
+
+long Motor::limitPosition(long position) {
+  if (_limitActive) {
+    if (position > _maxPosition) position = _maxPosition;
+    if (position < _minPosition) position = _minPosition;
+  }
+  return position;
+}
+
+void Motor::beginExternal(long target) {
+  if (_stepper) {
+    if (_timerChannel != 0xFF) {
+      stepTimer.setMotion(_timerChannel, 0, stepTimer.getPosition(_timerChannel));
+    }
+    _profile.reset();
+    _targetPosition = target;
+    _external = true;
+    _jog = false;
+    setState(RUNNING);
     enable();
   }
 }
 
+void Motor::endExternal() {
+  if (_external) {
+    _external = false;
+    setState(STOPPED);
+    if (_timerChannel == 0xFF) {
+      _stepper->setCurrentPosition(_stepper->currentPosition());
+    }
+  }
+}
+
+void Motor::step(int8_t direction) {
+  _driver->step(direction > 0);
+  _stepper->setCurrentPosition(_stepper->currentPosition() + direction);
+}
+
+// Chases a moving setpoint: feed-forward velocity plus a correction towards the position
+void Motor::follow(long position, float velocity) {
+  float speed = velocity + (position - getCurrentPosition()) * TRAJECTORY_CATCHUP;
+  float limit = getMaxSpeed();
+  setSpeed(constrain(speed, -limit, limit));
+}
+
 MotorState Motor::getState() {
   return _state;
 }
 
+// Only plain polled moves can be predicted; everything else wants every update
+unsigned long Motor::getTimeToNextStep(unsigned long now) {
+  if (_timerChannel != 0xFF || _external || _jog || _state != RUNNING || _profile.getJerk() > 0.0) {
+    return 0;
+  }
+  
+  float speed = fabs(_stepper->speed());
+  if (speed == 0.0) return 0;
+  
+  unsigned long interval = 1000000.0 / speed;
+  unsigned long elapsed = now - _lastStepTime;
+  return elapsed >= interval ? 0 : interval - elapsed;
+}
+
+float Motor::getSpeed() {
+  return _stepper ? _stepper->speed() : 0.0;
+}
+
 long Motor::getCurrentPosition() {
+  if (_timerChannel != 0xFF) {
+    return stepTimer.getPosition(_timerChannel);
+  }
   return _stepper ? _stepper->currentPosition() : 0;
 }
 
 float Motor::getCurrentPositionUnit() {
-  return getCurrentPosition() / _stepsPerUnit;
+  return getCurrentPosition() * _unitsPerStep;
+}
+
+float Motor::getStepsPerUnit() {
+  return _stepsPerUnit;
 }
 
 long Motor::getTargetPosition() {
+  if (_timerChannel != 0xFF || _external) {
+    return _targetPosition;
+  }
   return _stepper ? _stepper->targetPosition() : 0;
 }
 
 float Motor::getTargetPositionUnit() {
-  return getTargetPosition() / _stepsPerUnit;
+  return getTargetPosition() * _unitsPerStep;
 }
 
 bool Motor::isRunning() {
   return _state == RUNNING || _state == HOMING;
 }
 
+bool Motor::isJogging() {
+  return _jog;
+}
+
+// Time from a jog starting at rest to its first step, handed out once
+unsigned long Motor::takeJogLatency() {
+  unsigned long latency = _jogLatency;
+  _jogLatency = 0;
+  return latency;
+}
+
+long Motor::takePositionShift() {
+  long shift = _positionShift;
+  _positionShift = 0;
+  return shift;
+}
+
+bool Motor::isDirectionInverted() {
+  return _directionInverted;
+}
+
+bool Motor::isLimitActive() {
+  return _limitActive;
+}
+
+bool Motor::isHoming() {
+  return _state == HOMING;
+}
+
+bool Motor::hasLimitSwitch() {
+  return _limitPin != 0xFF;
+}
+
+bool Motor::isLimitTriggered() {
+  if (_limitPin == 0xFF) return false;
+  return digitalRead(_limitPin) == (_limitActiveLow ? LOW : HIGH);
+}
+
 bool Motor::isEnabled() {
   if (_enablePin != 0xFF) {
-    return digitalRead(_enablePin) != _enableInverted;
+    return _driver->readEnable() != _enableInverted;
   }
   return false;
 }
 
+bool Motor::isTimerDriven() {
+  return _timerChannel != 0xFF;
+}
+
+bool Motor::isExternallyDriven() {
+  return _external;
+}
+
+uint8_t Motor::getTimerChannel() {
+  return _timerChannel;
+}
+
+float Motor::getMaxSpeed() {
+  return _profile.getMaxSpeed();
+}
+
+float Motor::getAcceleration() {
+  return _profile.getAcceleration();
+}
+
+float Motor::getJerk() {
+  return _profile.getJerk();
+}
+
+RampTable* Motor::getRampTable() {
+  return &_ramp;
+}
+
 long Motor::distanceToGo() {
+  if (_timerChannel != 0xFF || _external) {
+    return _targetPosition - getCurrentPosition();
+  }
   return _stepper ? _stepper->distanceToGo() : 0;
 }
 
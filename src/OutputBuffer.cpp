@@ -0,0 +1,92 @@
+#include "../inc/OutputBuffer.hpp"
+
+OutputBuffer Output;
+VerboseOutput Verbose;
+
+OutputBuffer::OutputBuffer() {
+  _head = 0;
+  _count = 0;
+  _quiet = false;
+  _lineStart = true;
+  _dropping = false;
+  _dropped = 0;
+}
+
+void OutputBuffer::push(uint8_t data) {
+  _buffer[(_head + _count) % OUTPUT_BUFFER_SIZE] = data;
+  _count++;
+  _lineStart = (data == '\n');
+}
+
+size_t OutputBuffer::write(uint8_t data) {
+  while (_count >= OUTPUT_BUFFER_SIZE) {
+    Serial.write(_buffer[_head]);
+    _head = (_head + 1) % OUTPUT_BUFFER_SIZE;
+    _count--;
+  }
+  
+  push(data);
+  return 1;
+}
+
+size_t OutputBuffer::writeVerbose(uint8_t data) {
+  if (_quiet) {
+    return 1;
+  }
+  
+  if (_lineStart && !_dropping && getFree() < OUTPUT_LINE_RESERVE) {
+    _dropping = true;
+  }
+  
+  if (_dropping || _count >= OUTPUT_BUFFER_SIZE) {
+    _dropping = (data != '\n');
+    _lineStart = !_dropping;
+    _dropped++;
+    return 1;
+  }
+  
+  push(data);
+  return 1;
+}
+
+void OutputBuffer::drain() {
+  int room = Serial.availableForWrite();
+  
+  while (_count > 0 && room-- > 0) {
+    Serial.write(_buffer[_head]);
+    _head = (_head + 1) % OUTPUT_BUFFER_SIZE;
+    _count--;
+  }
+}
+
+void OutputBuffer::flush() {
+  while (_count > 0) {
+    Serial.write(_buffer[_head]);
+    _head = (_head + 1) % OUTPUT_BUFFER_SIZE;
+    _count--;
+  }
+}
+
+uint16_t OutputBuffer::getPending() {
+  return _count;
+}
+
+uint16_t OutputBuffer::getFree() {
+  return OUTPUT_BUFFER_SIZE - _count;
+}
+
+unsigned long OutputBuffer::getDropped() {
+  return _dropped;
+}
+
+void OutputBuffer::setQuiet(bool quiet) {
+  _quiet = quiet;
+}
+
+bool OutputBuffer::isQuiet() {
+  return _quiet;
+}
+
+size_t VerboseOutput::write(uint8_t data) {
+  return Output.writeVerbose(data);
+}
@@ -0,0 +1,46 @@
+#include "../inc/PinDriver.hpp"
+
+PinDriver::PinDriver(uint8_t stepPin, uint8_t dirPin, uint8_t enablePin) {
+  _stepPin = stepPin;
+  _dirPin = dirPin;
+  _enablePin = enablePin;
+  _directionInverted = false;
+}
+
+void PinDriver::setDirectionInverted(bool inverted) {
+  _directionInverted = inverted;
+}
+
+void PinDriver::begin() {
+  pinMode(_stepPin, OUTPUT);
+  pinMode(_dirPin, OUTPUT);
+  if (_enablePin != 0xFF) {
+    pinMode(_enablePin, OUTPUT);
+  }
+}
+
+void PinDriver::step(bool forward) {
+  digitalWrite(_dirPin, forward != _directionInverted ? HIGH : LOW);
+  digitalWrite(_stepPin, HIGH);
+  delayMicroseconds(1);
+  digitalWrite(_stepPin, LOW);
+}
+
+void PinDriver::writeEnable(bool level) {
+  if (_enablePin != 0xFF) {
+    digitalWrite(_enablePin, level ? HIGH : LOW);
+  }
+}
+
+bool PinDriver::readEnable() {
+  return _enablePin != 0xFF && digitalRead(_enablePin) != LOW;
+}
+
+DriverStepper::DriverStepper(PinDriver* driver, uint8_t stepPin, uint8_t dirPin)
+  : AccelStepper(AccelStepper::DRIVER, stepPin, dirPin) {
+  _driver = driver;
+}
+
+void DriverStepper::step(long) {
+  _driver->step(_direction == DIRECTION_CW);
+}
@@ -0,0 +1,56 @@
+#include "../inc/PlatformKinematics.hpp"
+
+PlatformKinematics::PlatformKinematics() {
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+    _x[i] = 0;
+    _y[i] = 0;
+  }
+  
+  setAttachment(0, PLATFORM_HALF_WIDTH, PLATFORM_HALF_DEPTH);
+  setAttachment(1, -PLATFORM_HALF_WIDTH, PLATFORM_HALF_DEPTH);
+  setAttachment(2, -PLATFORM_HALF_WIDTH, -PLATFORM_HALF_DEPTH);
+  setAttachment(3, PLATFORM_HALF_WIDTH, -PLATFORM_HALF_DEPTH);
+}
+
+bool PlatformKinematics::setAttachment(uint8_t axis, float x, float y) {
+  if (axis >= MAX_MOTORS || fabs(x) >= PLATFORM_MAX_ATTACHMENT || fabs(y) >= PLATFORM_MAX_ATTACHMENT) {
+    return false;
+  }
+  
+  _x[axis] = (long)(x * 256.0);
+  _y[axis] = (long)(y * 256.0);
+  return true;
+}
+
+float PlatformKinematics::getAttachmentX(uint8_t axis) {
+  return axis < MAX_MOTORS ? _x[axis] / 256.0 : 0.0;
+}
+
+float PlatformKinematics::getAttachmentY(uint8_t axis) {
+  return axis < MAX_MOTORS ? _y[axis] / 256.0 : 0.0;
+}
+
+void PlatformKinematics::solveEuler(uint16_t roll, uint16_t pitch, long heave, uint8_t axisCount, long offsets[]) {
+  long sinPitch = sinQ15(pitch);
+  long cosPitch = cosQ15(pitch);
+  long sinRoll = sinQ15(roll);
+  long rollTerm = (sinRoll * cosPitch) >> 15;
+  
+  for (uint8_t i = 0; i < axisCount && i < MAX_MOTORS; i++) {
+    offsets[i] = heave + ((_y[i] * rollTerm) >> 15) - ((_x[i] * sinPitch) >> 15);
+  }
+}
+
+void PlatformKinematics::solveQuaternion(int16_t w, int16_t x, int16_t y, int16_t z, long heave, uint8_t axisCount, long offsets[]) {
+  long xTerm = ((long)x * z - (long)w * y) >> 12;
+  long yTerm = ((long)y * z + (long)w * x) >> 12;
+  
+  // Only a unit quaternion keeps these within Q15 one; bound the rest so the
+  // products below cannot overflow
+  xTerm = constrain(xTerm, -32768L, 32768L);
+  yTerm = constrain(yTerm, -32768L, 32768L);
+  
+  for (uint8_t i = 0; i < axisCount && i < MAX_MOTORS; i++) {
+    offsets[i] = heave + ((_x[i] * xTerm) >> 15) + ((_y[i] * yTerm) >> 15);
+  }
+}
@@ -0,0 +1,110 @@
+#include "../inc/RampTable.hpp"
+
+#if RAMP_TABLE_PROGMEM
+// sqrt(i) in Q12; entry i of any ramp is sqrt(2 * accel * stride) * sqrt(i)
+static const uint16_t SQRT_TABLE[64] PROGMEM = {
+  0, 4096, 5793, 7094, 8192, 9159, 10033, 10837,
+  11585, 12288, 12953, 13585, 14189, 14768, 15326, 15864,
+  16384, 16888, 17378, 17854, 18318, 18770, 19212, 19644,
+  20066, 20480, 20886, 21283, 21674, 22058, 22435, 22806,
+  23170, 23530, 23884, 24232, 24576, 24915, 25249, 25580,
+  25905, 26227, 26545, 26859, 27170, 27477, 27780, 28081,
+  28378, 28672, 28963, 29251, 29537, 29819, 30099, 30377,
+  30652, 30924, 31194, 31462, 31727, 31991, 32252, 32511
+};
+#endif
+
+RampTable::RampTable() {
+#if RAMP_TABLE_PROGMEM
+  _scale = 0;
+#endif
+  _maxSpeed = 0;
+  _rampSteps = 0;
+  _doubleAccel = 0;
+  _shift = 0;
+  _valid = false;
+}
+
+void RampTable::build(float maxSpeed, float acceleration) {
+  maxSpeed = fabs(maxSpeed);
+  acceleration = fabs(acceleration);
+  _valid = false;
+  
+  if (maxSpeed < 1.0 || acceleration < 1.0) return;
+  
+  _maxSpeed = maxSpeed >= 32767.0 ? 32767 : (uint16_t)maxSpeed;
+  _rampSteps = (uint32_t)((float)_maxSpeed * _maxSpeed / (2.0 * acceleration)) + 1;
+  _doubleAccel = acceleration >= 32767.0 ? 65534UL : (uint32_t)(2.0 * acceleration);
+  
+  // Smallest power-of-two stride that lets the table cover the whole ramp
+  _shift = 0;
+  while (((uint32_t)(RAMP_TABLE_SIZE - 1) << _shift) < _rampSteps) {
+    if (++_shift > 16) return;
+  }
+  
+  float scale = sqrt(2.0 * acceleration * ((uint32_t)1 << _shift));
+  
+#if RAMP_TABLE_PROGMEM
+  _scale = scale >= 65535.0 ? 65535UL : (uint32_t)scale;
+#else
+  for (uint8_t i = 0; i < RAMP_TABLE_SIZE; i++) {
+    float speed = scale * sqrt((float)i);
+    _speeds[i] = speed >= _maxSpeed ? _maxSpeed : (uint16_t)speed;
+  }
+#endif
+  
+  _valid = true;
+}
+
+void RampTable::clear() {
+  _valid = false;
+}
+
+uint16_t RampTable::entry(uint8_t index) {
+#if RAMP_TABLE_PROGMEM
+  uint32_t speed = (_scale * pgm_read_word(&SQRT_TABLE[index])) >> 12;
+  return speed >= _maxSpeed ? _maxSpeed : (uint16_t)speed;
+#else
+  return _speeds[index];
+#endif
+}
+
+fixed_t RampTable::speedAt(uint32_t distance) {
+  if (distance >= _rampSteps) {
+    return (fixed_t)_maxSpeed << 16;
+  }
+  
+  uint8_t index = distance >> _shift;
+  
+  // Interpolating the first stride would crawl into the target; the root is cheap there
+  if (index == 0 && distance < 0x10000UL) {
+    uint32_t speed = isqrt32(distance * _doubleAccel);
+    return speed >= _maxSpeed ? (fixed_t)_maxSpeed << 16 : (fixed_t)speed << 16;
+  }
+  
+  uint16_t low = entry(index);
+  uint16_t high = entry(index + 1);
+  uint32_t remainder = distance & (((uint32_t)1 << _shift) - 1);
+  
+  return ((fixed_t)low << 16) + (fixed_t)(((uint32_t)(high - low) * remainder) << (16 - _shift));
+}
+
+bool RampTable::isValid() {
+  return _valid;
+}
+
+uint32_t RampTable::getRampSteps() {
+  return _rampSteps;
+}
+
+uint32_t RampTable::getStride() {
+  return (uint32_t)1 << _shift;
+}
+
+uint8_t RampTable::getEntryCount() {
+  return RAMP_TABLE_SIZE;
+}
+
+uint16_t RampTable::getMemoryUsage() {
+  return sizeof(RampTable);
+}
@@ -0,0 +1,198 @@
+#include "../inc/RuntimeStats.hpp"
+
+RuntimeStats::RuntimeStats() {
+  _lastUpdate = 0;
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+    _lastPosition[i] = 0;
+  }
+  reset();
+}
+
+void RuntimeStats::reset() {
+  _started = false;
+  _resetTime = millis();
+  _updates = 0;
+  _maxPeriod = 0;
+  _maxCommandTime = 0;
+  _rxOverflows = 0;
+  _mailboxApplied = 0;
+  _mailboxCoalesced = 0;
+  _staleness = 0;
+  _maxStaleness = 0;
+  
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+    _histogram[i] = 0;
+  }
+  
+  // Positions are kept so steps taken around a reset are still counted once
+  for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+    _steps[i] = 0;
+    _lateSteps[i] = 0;
+    _jogLatency[i] = 0;
+    _maxJogLatency[i] = 0;
+  }
+}
+
+unsigned long RuntimeStats::recordUpdate(unsigned long now) {
+  unsigned long period = now - _lastUpdate;
+  _lastUpdate = now;
+  
+  if (!_started) {
+    _started = true;
+    return 0;
+  }
+  
+  // Bucket n holds periods of 2^(n-1) to 2^n - 1 microseconds
+  uint8_t bucket = 0;
+  for (unsigned long remaining = period; remaining && bucket < STATS_HISTOGRAM_BUCKETS - 1; remaining >>= 1) {
+    bucket++;
+  }
+  
+  _histogram[bucket]++;
+  _updates++;
+  if (period > _maxPeriod) _maxPeriod = period;
+  
+  return period;
+}
+
+void RuntimeStats::recordCommand(unsigned long elapsed) {
+  if (elapsed > _maxCommandTime) _maxCommandTime = elapsed;
+}
+
+void RuntimeStats::recordRxOverflow() {
+  _rxOverflows++;
+}
+
+void RuntimeStats::recordPosition(uint8_t motor, long position) {
+  _steps[motor] += labs(position - _lastPosition[motor]);
+  _lastPosition[motor] = position;
+}
+
+void RuntimeStats::shiftPosition(uint8_t motor, long shift) {
+  _lastPosition[motor] += shift;
+}
+
+void RuntimeStats::recordLateStep(uint8_t motor) {
+  _lateSteps[motor]++;
+}
+
+void RuntimeStats::recordJogLatency(uint8_t motor, unsigned long latency) {
+  _jogLatency[motor] = latency;
+  if (latency > _maxJogLatency[motor]) _maxJogLatency[motor] = latency;
+}
+
+void RuntimeStats::recordCoalesced(uint8_t count) {
+  _mailboxCoalesced += count;
+}
+
+void RuntimeStats::recordStaleness(unsigned long age) {
+  _mailboxApplied++;
+  _staleness = age;
+  if (age > _maxStaleness) _maxStaleness = age;
+}
+
+unsigned long RuntimeStats::getUpdates() {
+  return _updates;
+}
+
+unsigned long RuntimeStats::getMaxPeriod() {
+  return _maxPeriod;
+}
+
+unsigned long RuntimeStats::getHistogram(uint8_t bucket) {
+  return bucket < STATS_HISTOGRAM_BUCKETS ? _histogram[bucket] : 0;
+}
+
+unsigned long RuntimeStats::getMaxCommandTime() {
+  return _maxCommandTime;
+}
+
+unsigned long RuntimeStats::getRxOverflows() {
+  return _rxOverflows;
+}
+
+unsigned long RuntimeStats::getSteps(uint8_t motor) {
+  return motor < MAX_MOTORS ? _steps[motor] : 0;
+}
+
+unsigned long RuntimeStats::getLateSteps(uint8_t motor) {
+  return motor < MAX_MOTORS ? _lateSteps[motor] : 0;
+}
+
+unsigned long RuntimeStats::getMaxJogLatency(uint8_t motor) {
+  return motor < MAX_MOTORS ? _maxJogLatency[motor] : 0;
+}
+
+unsigned long RuntimeStats::getMailboxCoalesced() {
+  return _mailboxCoalesced;
+}
+
+unsigned long RuntimeStats::getMaxStaleness() {
+  return _maxStaleness;
+}
+
+void RuntimeStats::print(Print& out, uint8_t motorCount) {
+  out.println(F("-- Runtime Stats --"));
+  out.print(F("Since reset: "));
+  out.print(millis() - _resetTime);
+  out.println(F(" ms"));
+  
+  out.print(F("Updates: "));
+  out.print(_updates);
+  out.print(F(" Max period: "));
+  out.print(_maxPeriod);
+  out.println(F(" us"));
+  
+  // Only buckets that saw an update, labelled by their upper bound
+  out.print(F("Period histogram (us):"));
+  for (uint8_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+    if (_histogram[i] == 0) continue;
+    
+    out.print(' ');
+    if (i == STATS_HISTOGRAM_BUCKETS - 1) {
+      out.print('>');
+      out.print((1UL << (i - 1)) - 1);
+    } else {
+      out.print('<');
+      out.print(1UL << i);
+    }
+    out.print(':');
+    out.print(_histogram[i]);
+  }
+  out.println();
+  
+  out.print(F("Max command: "));
+  out.print(_maxCommandTime);
+  out.print(F(" us RX overflows: "));
+  out.println(_rxOverflows);
+  
+  if (_mailboxApplied > 0) {
+    out.print(F("Mailbox: Applied:"));
+    out.print(_mailboxApplied);
+    out.print(F(" Coalesced:"));
+    out.print(_mailboxCoalesced);
+    out.print(F(" Staleness:"));
+    out.print(_staleness);
+    out.print('/');
+    out.print(_maxStaleness);
+    out.println(F(" us"));
+  }
+  
+  for (uint8_t i = 0; i < motorCount; i++) {
+    out.print(F("Motor "));
+    out.print(i);
+    out.print(F(": Steps:"));
+    out.print(_steps[i]);
+    out.print(F(" Late:"));
+    out.print(_lateSteps[i]);
+    
+    if (_maxJogLatency[i] > 0) {
+      out.print(F(" Jog latency:"));
+      out.print(_jogLatency[i]);
+      out.print('/');
+      out.print(_maxJogLatency[i]);
+      out.print(F(" us"));
+    }
+    out.println();
+  }
+}
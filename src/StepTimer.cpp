@@ -0,0 +1,262 @@
+#include "../inc/StepTimer.hpp"
+
+StepTimer stepTimer;
+
+StepTimer::StepTimer() {
+  _channelCount = 0;
+  _running = false;
+  _ticks = 0;
+  _groupMask = 0;
+  _groupRate = 0;
+  _groupAccumulator = 0;
+  _groupRemaining = 0;
+  _groupTotal = 0;
+}
+
+uint8_t StepTimer::attach(uint8_t stepPin, uint8_t dirPin) {
+  if (_channelCount >= MAX_MOTORS) {
+    return 0xFF;
+  }
+  
+  StepChannel& channel = _channels[_channelCount];
+  channel.stepPin = stepPin;
+  channel.dirPin = dirPin;
+  channel.stepPort = portOutputRegister(digitalPinToPort(stepPin));
+  channel.dirPort = portOutputRegister(digitalPinToPort(dirPin));
+  channel.stepMask = digitalPinToBitMask(stepPin);
+  channel.dirMask = digitalPinToBitMask(dirPin);
+  channel.dirInverted = false;
+  channel.pulseHigh = false;
+  channel.direction = 1;
+  channel.rate = 0;
+  channel.accumulator = 0;
+  channel.position = 0;
+  channel.stopAt = 0;
+  
+  pinMode(stepPin, OUTPUT);
+  pinMode(dirPin, OUTPUT);
+  digitalWrite(stepPin, LOW);
+  writeDirection(channel);
+  
+  return _channelCount++;
+}
+
+void StepTimer::begin() {
+  if (_running) return;
+  
+#ifdef __AVR__
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);
+  OCR1A = (F_CPU / 8 / STEP_TIMER_FREQUENCY) - 1;
+  TCNT1 = 0;
+  TIMSK1 |= _BV(OCIE1A);
+  interrupts();
+#endif
+  
+  _running = true;
+}
+
+void StepTimer::end() {
+#ifdef __AVR__
+  TIMSK1 &= ~_BV(OCIE1A);
+#endif
+  _running = false;
+}
+
+bool StepTimer::isRunning() {
+  return _running;
+}
+
+void StepTimer::writeDirection(StepChannel& channel) {
+  bool level = (channel.direction > 0) != channel.dirInverted;
+  
+  if (level) {
+    *channel.dirPort |= channel.dirMask;
+  }
+  else {
+    *channel.dirPort &= ~channel.dirMask;
+  }
+  
+#ifndef __AVR__
+  digitalWrite(channel.dirPin, level ? HIGH : LOW);
+#endif
+}
+
+uint16_t StepTimer::speedToRate(fixed_t speed) {
+  uint32_t rate = (uint32_t)labs(speed) / STEP_TIMER_FREQUENCY;
+  return rate >= 65535UL ? 65535 : (uint16_t)rate;
+}
+
+void StepTimer::setMotion(uint8_t channel, fixed_t speed, long stopAt) {
+  if (channel >= _channelCount) return;
+  
+  StepChannel& ch = _channels[channel];
+  uint16_t rate = speedToRate(speed);
+  int8_t direction = speed < 0 ? -1 : 1;
+  
+  noInterrupts();
+  if (direction != ch.direction) {
+    ch.direction = direction;
+    writeDirection(ch);
+  }
+  ch.rate = rate;
+  ch.stopAt = stopAt;
+  interrupts();
+}
+
+void StepTimer::setDirectionInverted(uint8_t channel, bool inverted) {
+  if (channel >= _channelCount) return;
+  
+  noInterrupts();
+  _channels[channel].dirInverted = inverted;
+  writeDirection(_channels[channel]);
+  interrupts();
+}
+
+void StepTimer::setPosition(uint8_t channel, long position) {
+  if (channel >= _channelCount) return;
+  
+  noInterrupts();
+  _channels[channel].position = position;
+  _channels[channel].stopAt = position;
+  _channels[channel].rate = 0;
+  interrupts();
+}
+
+long StepTimer::getPosition(uint8_t channel) {
+  if (channel >= _channelCount) return 0;
+  
+  noInterrupts();
+  long position = _channels[channel].position;
+  interrupts();
+  return position;
+}
+
+bool StepTimer::isStepping(uint8_t channel) {
+  if (channel >= _channelCount) return false;
+  
+  noInterrupts();
+  StepChannel& ch = _channels[channel];
+  bool stepping = ch.rate != 0 && (ch.direction > 0 ? ch.position < ch.stopAt : ch.position > ch.stopAt);
+  interrupts();
+  return stepping;
+}
+
+unsigned long StepTimer::getTicks() {
+  noInterrupts();
+  unsigned long ticks = _ticks;
+  interrupts();
+  return ticks;
+}
+
+// Direction writes share ports with pins the ISR pulses, so all of the setup
+// runs with interrupts off
+void StepTimer::beginGroup(uint8_t mask, const long deltas[], long totalSteps) {
+  noInterrupts();
+  _groupMask = 0;
+  
+  for (uint8_t i = 0; i < _channelCount; i++) {
+    if (!(mask & (1 << i))) continue;
+    
+    StepChannel& ch = _channels[i];
+    ch.rate = 0;
+    ch.direction = deltas[i] < 0 ? -1 : 1;
+    writeDirection(ch);
+    _groupDelta[i] = labs(deltas[i]);
+    _groupError[i] = totalSteps >> 1;
+  }
+  
+  _groupTotal = totalSteps;
+  _groupRemaining = totalSteps;
+  _groupRate = 0;
+  _groupAccumulator = 0;
+  _groupMask = mask;
+  interrupts();
+}
+
+void StepTimer::setGroupRate(fixed_t speed) {
+  uint16_t rate = speedToRate(speed);
+  
+  noInterrupts();
+  _groupRate = rate;
+  interrupts();
+}
+
+long StepTimer::getGroupRemaining() {
+  noInterrupts();
+  long remaining = _groupRemaining;
+  interrupts();
+  return remaining;
+}
+
+void StepTimer::endGroup() {
+  noInterrupts();
+  _groupMask = 0;
+  _groupRate = 0;
+  _groupRemaining = 0;
+  interrupts();
+}
+
+void StepTimer::tick() {
+  for (uint8_t i = 0; i < _channelCount; i++) {
+    StepChannel& ch = _channels[i];
+    
+    if (ch.pulseHigh) {
+      *ch.stepPort &= ~ch.stepMask;
+      ch.pulseHigh = false;
+    }
+    
+    if (ch.rate == 0 || (_groupMask & (1 << i))) continue;
+    if (ch.direction > 0 ? ch.position >= ch.stopAt : ch.position <= ch.stopAt) continue;
+    
+    uint16_t previous = ch.accumulator;
+    ch.accumulator += ch.rate;
+    
+    if (ch.accumulator < previous) {
+      *ch.stepPort |= ch.stepMask;
+      ch.pulseHigh = true;
+      ch.position += ch.direction;
+    }
+  }
+  
+  if (_groupMask && _groupRemaining > 0) {
+    uint16_t previous = _groupAccumulator;
+    _groupAccumulator += _groupRate;
+    
+    if (_groupAccumulator < previous) {
+      _groupRemaining--;
+      
+      for (uint8_t i = 0; i < _channelCount; i++) {
+        if (!(_groupMask & (1 << i))) continue;
+        
+        _groupError[i] += _groupDelta[i];
+        if (_groupError[i] >= _groupTotal) {
+          _groupError[i] -= _groupTotal;
+          StepChannel& ch = _channels[i];
+          *ch.stepPort |= ch.stepMask;
+          ch.pulseHigh = true;
+          ch.position += ch.direction;
+        }
+      }
+    }
+  }
+  
+  _ticks++;
+}
+
+#ifdef __AVR__
+#if STEP_TIMER_ENABLED
+ISR(TIMER1_COMPA_vect) {
+  stepTimer.tick();
+}
+#endif
+#else
+void StepTimer::advance(unsigned long ticks) {
+  if (!_running) return;
+  
+  while (ticks--) {
+    tick();
+  }
+}
+#endif
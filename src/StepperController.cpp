@@ -1,9 +1,13 @@
 #include "../inc/StepperController.hpp"
+#include <limits.h>
 
 StepperController::StepperController() {
   _motorCount = 0;
+  _activeMask = 0;
   _emergencyStop = false;
   _lastUpdateTime = 0;
+  _binaryMode = false;
+  _userCommandCount = 0;
 }
 
 uint8_t StepperController::addMotor(uint8_t stepPin, uint8_t dirPin, uint8_t enablePin, uint8_t interface, bool enableInverted) {
@@ -11,9 +15,29 @@ uint8_t StepperController::addMotor(uint8_t stepPin, uint8_t dirPin, uint8_t ena
     return 0xFF;
   }
   
-  AccelStepper* stepper = new AccelStepper(interface, stepPin, dirPin);
+  MotorStorage* storage = _motors[_motorCount].getStorage();
+  AccelStepper* stepper = new (storage->stepper) AccelStepper(interface, stepPin, dirPin);
+  PinDriver* driver = new (storage->driver) PinDriver(stepPin, dirPin, enablePin);
   
-  _motors[_motorCount].init(_motorCount, stepper, enablePin, enableInverted);
+  return attachMotor(stepper, driver, stepPin, dirPin, enablePin, enableInverted);
+}
+
+uint8_t StepperController::attachMotor(AccelStepper* stepper, PinDriver* driver, uint8_t stepPin, uint8_t dirPin, uint8_t enablePin, bool enableInverted) {
+  _motors[_motorCount].init(_motorCount, stepper, driver, enablePin, enableInverted);
+  _motors[_motorCount].setActiveMask(&_activeMask);
+  
+#if STEP_TIMER_ENABLED
+  _motors[_motorCount].attachTimer(stepTimer.attach(stepPin, dirPin));
+  stepTimer.begin();
+#else
+  (void)stepPin;
+  (void)dirPin;
+#endif
+  
+  _planner.begin(_motors, _motorCount + 1);
+  _telemetry.begin(_motors, _motorCount + 1);
+  _trajectory.begin(_motors, _motorCount + 1);
+  _config.begin(_motors, _motorCount + 1);
   
   return _motorCount++;
 }
@@ -53,6 +77,10 @@ void StepperController::emergencyStop(bool resume) {
   _emergencyStop = !resume;
   
   if (_emergencyStop) {
+    _trajectory.clear();
+    _coordinatedMove.stop();
+    _planner.clear();
+    _mailbox.clear();
     for (uint8_t i = 0; i < _motorCount; i++) {
       _motors[i].stop();
     }
@@ -61,27 +89,269 @@ void StepperController::emergencyStop(bool resume) {
 }
 
 void StepperController::stopAll() {
+  _trajectory.clear();
+  _coordinatedMove.stop();
+  _planner.clear();
   for (uint8_t i = 0; i < _motorCount; i++) {
     _motors[i].stop();
   }
 }
 
+// Every motor homes at once; motors without a switch return to their home position
 void StepperController::homeAll() {
+  if (_emergencyStop) return;
+  
+  _trajectory.clear();
+  _coordinatedMove.stop();
+  _planner.clear();
   for (uint8_t i = 0; i < _motorCount; i++) {
     _motors[i].home();
   }
 }
 
+bool StepperController::isAnyHoming() {
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    if (_motors[i].isHoming()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void StepperController::runAll() {
   if (_emergencyStop) return;
   
-  for (uint8_t i = 0; i < _motorCount; i++) {
-    _motors[i].run();
+  _trajectory.run();
+  _coordinatedMove.run();
+  
+  if (!_coordinatedMove.isActive() && !_planner.isEmpty()) {
+    startNextSegment();
+  }
+  
+  uint8_t mask = _activeMask;
+  for (uint8_t i = 0; mask; i++, mask >>= 1) {
+    if (mask & 1) {
+      _motors[i].run();
+    }
   }
   
   _lastUpdateTime = millis();
 }
 
+// Only an emergency stop or a target outside the limits is refused; a move
+// that is already complete still counts as accepted
+bool StepperController::moveToAll(const long targets[]) {
+  if (!checkTargets(targets)) return false;
+  
+  _trajectory.clear();
+  _coordinatedMove.retarget(_motors, _motorCount, targets);
+  _planner.clear();
+  return true;
+}
+
+// Jogging takes the axes over from coordinated moves, queued segments and waypoints
+bool StepperController::jog(uint8_t motor, float velocity) {
+  if (_emergencyStop || motor >= _motorCount) return false;
+  
+  releaseAxes();
+  _motors[motor].jog(velocity);
+  return true;
+}
+
+bool StepperController::jogAll(const float velocities[]) {
+  if (_emergencyStop) return false;
+  
+  releaseAxes();
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    _motors[i].jog(velocities[i]);
+  }
+  return true;
+}
+
+void StepperController::releaseAxes() {
+  if (_trajectory.isActive() || _coordinatedMove.isActive() || !_planner.isEmpty()) {
+    _trajectory.clear();
+    _coordinatedMove.stop();
+    _planner.clear();
+  }
+}
+
+// Every target is checked before any motor is touched, so a rejected command moves nothing
+bool StepperController::setTargets(const long targets[]) {
+  if (!checkTargets(targets)) return false;
+  
+  _trajectory.clear();
+  _coordinatedMove.stop();
+  _planner.clear();
+  
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    _motors[i].moveTo(targets[i]);
+  }
+  return true;
+}
+
+bool StepperController::checkTargets(const long targets[]) {
+  if (_emergencyStop) return false;
+  
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    if (_motors[i].limitPosition(targets[i]) != targets[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Coalesced targets are clamped when posted so the sender still hears about it
+bool StepperController::postMove(uint8_t motor, long position) {
+  if (motor >= _motorCount) return false;
+  
+  long targets[MAX_MOTORS];
+  targets[motor] = _motors[motor].limitPosition(position);
+  postToMailbox(MAILBOX_MOVE, 1 << motor, targets);
+  return targets[motor] == position;
+}
+
+bool StepperController::postTargets(const long targets[]) {
+  if (!checkTargets(targets)) return false;
+  
+  postToMailbox(MAILBOX_MOVE, (1 << _motorCount) - 1, targets);
+  return true;
+}
+
+bool StepperController::postPath(const long targets[]) {
+  if (!checkTargets(targets)) return false;
+  
+  postToMailbox(MAILBOX_PATH, (1 << _motorCount) - 1, targets);
+  return true;
+}
+
+void StepperController::setCoalescing(bool enabled) {
+  flushMailbox();
+  _mailbox.setEnabled(enabled);
+}
+
+bool StepperController::isCoalescing() {
+  return _mailbox.isEnabled();
+}
+
+// Independent moves and coordinated paths never share the slot; switching
+// kinds applies what is waiting first so the two stay in order
+void StepperController::postToMailbox(uint8_t kind, uint8_t mask, const long targets[]) {
+  if (!_mailbox.isEmpty() && _mailbox.getKind() != kind) {
+    flushMailbox();
+  }
+  _stats.recordCoalesced(_mailbox.post(kind, mask, targets, micros()));
+}
+
+void StepperController::flushMailbox() {
+  if (_mailbox.isEmpty() || _emergencyStop) return;
+  
+  uint8_t kind = _mailbox.getKind();
+  uint8_t mask = _mailbox.getMask();
+  long targets[MAX_MOTORS];
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    targets[i] = _mailbox.getTarget(i);
+  }
+  _stats.recordStaleness(_mailbox.take(micros()));
+  
+  if (kind == MAILBOX_PATH) {
+    moveToAll(targets);
+    return;
+  }
+  
+  if (mask == (1 << _motorCount) - 1) {
+    _trajectory.clear();
+    _coordinatedMove.stop();
+    _planner.clear();
+  }
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    if (mask & (1 << i)) {
+      _motors[i].moveTo(targets[i]);
+    }
+  }
+}
+
+bool StepperController::queueMove(const long targets[]) {
+  if (_emergencyStop) return false;
+  
+  if (_planner.isEmpty() && !_coordinatedMove.isActive()) {
+    _planner.sync();
+  }
+  
+  if (!_planner.push(targets)) {
+    return false;
+  }
+  
+  if (_coordinatedMove.isActive()) {
+    _coordinatedMove.setExitSpeed(_planner.getExitSpeed());
+  }
+  return true;
+}
+
+void StepperController::startNextSegment() {
+  PlannerSegment* segment = _planner.peek();
+  long targets[MAX_MOTORS];
+  
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    targets[i] = i < _planner.getAxisCount() ? segment->target[i] : _motors[i].getTargetPosition();
+  }
+  
+  float entrySpeed = min(_coordinatedMove.getPathSpeed(), segment->entrySpeed);
+  
+  _planner.pop();
+  _planner.recalculate();
+  _coordinatedMove.start(_motors, _motorCount, targets, entrySpeed, _planner.getExitSpeed());
+}
+
+// Waypoints take over the axes from any coordinated move or queued segments
+bool StepperController::pushWaypoint(const long positions[], const float velocities[], uint16_t duration) {
+  if (_emergencyStop) return false;
+  
+  if (!_trajectory.isActive()) {
+    _coordinatedMove.stop();
+    _planner.clear();
+  }
+  return _trajectory.push(positions, velocities, duration);
+}
+
+uint8_t StepperController::getTrajectoryFree() {
+  return _trajectory.getFree();
+}
+
+Trajectory* StepperController::getTrajectory() {
+  return &_trajectory;
+}
+
+uint8_t StepperController::getQueueFree() {
+  return _planner.getFree();
+}
+
+bool StepperController::setPose(float roll, float pitch, float heave) {
+  long offsets[MAX_MOTORS];
+  _kinematics.solveEuler(degreesToAngle(roll), degreesToAngle(pitch), (long)(heave * 256.0), _motorCount, offsets);
+  return applyPose(offsets);
+}
+
+bool StepperController::setPoseQuaternion(float w, float x, float y, float z, float heave) {
+  long offsets[MAX_MOTORS];
+  _kinematics.solveQuaternion(floatToQ14(w), floatToQ14(x), floatToQ14(y), floatToQ14(z), (long)(heave * 256.0), _motorCount, offsets);
+  return applyPose(offsets);
+}
+
+bool StepperController::applyPose(const long offsets[]) {
+  long targets[MAX_MOTORS];
+  
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    targets[i] = _motors[i].getHomePosition() + (long)(offsets[i] * _motors[i].getStepsPerUnit() / 256.0);
+  }
+  
+  return _mailbox.isEnabled() ? postPath(targets) : moveToAll(targets);
+}
+
+PlatformKinematics* StepperController::getKinematics() {
+  return &_kinematics;
+}
+
 void StepperController::calibrateHomeAll() {
   for (uint8_t i = 0; i < _motorCount; i++) {
     _motors[i].calibrateHome();
@@ -104,13 +374,37 @@ uint8_t StepperController::getMotorCount() {
   return _motorCount;
 }
 
+// A target waiting in the mailbox counts as motion that has already begun
 bool StepperController::isAnyRunning() {
-  for (uint8_t i = 0; i < _motorCount; i++) {
-    if (_motors[i].isRunning()) {
-      return true;
+  return _activeMask != 0 || !_mailbox.isEmpty();
+}
+
+uint8_t StepperController::getActiveMask() {
+  return _activeMask;
+}
+
+// Microseconds the sketch can spend elsewhere before a polled motor is due to step:
+// 0 when something needs every update, ULONG_MAX when nothing is moving
+unsigned long StepperController::getTimeToNextStep() {
+  if (_coordinatedMove.isActive() || _trajectory.isActive() || !_planner.isEmpty() || !_mailbox.isEmpty()) {
+    return 0;
+  }
+  
+  unsigned long now = micros();
+  unsigned long wait = ULONG_MAX;
+  
+  uint8_t mask = _activeMask;
+  for (uint8_t i = 0; mask && wait > 0; i++, mask >>= 1) {
+    if (mask & 1) {
+      unsigned long motorWait = _motors[i].getTimeToNextStep(now);
+      if (motorWait < wait) wait = motorWait;
     }
   }
-  return false;
+  return wait;
+}
+
+bool StepperController::isCoordinatedMoveActive() {
+  return _coordinatedMove.isActive();
 }
 
 bool StepperController::isEmergencyStopped() {
@@ -122,48 +416,200 @@ unsigned long StepperController::getLastUpdateTime() {
 }
 
 void StepperController::printStatus() {
-  Serial.println(F("-- Motor Status --"));
+  Output.println(F("-- Motor Status --"));
   for (uint8_t i = 0; i < _motorCount; i++) {
-    Serial.print(F("Motor "));
-    Serial.print(i);
-    Serial.print(F(": "));
+    Output.print(F("Motor "));
+    Output.print(i);
+    Output.print(F(": "));
     
     switch (_motors[i].getState()) {
-      case STOPPED: Serial.print(F("STOPPED")); break;
-      case RUNNING: Serial.print(F("RUNNING")); break;
-      case PAUSED: Serial.print(F("PAUSED")); break;
-      case HOMING: Serial.print(F("HOMING")); break;
-      case ERROR: Serial.print(F("ERROR")); break;
-      default: Serial.print(F("UNKNOWN")); break;
+      case STOPPED: Output.print(F("STOPPED")); break;
+      case RUNNING: Output.print(F("RUNNING")); break;
+      case PAUSED: Output.print(F("PAUSED")); break;
+      case HOMING: Output.print(F("HOMING")); break;
+      case ERROR: Output.print(F("ERROR")); break;
+      default: Output.print(F("UNKNOWN")); break;
     }
     
-    Serial.print(F(" Pos:"));
-    Serial.print(_motors[i].getCurrentPosition());
-    Serial.print(F(" Target:"));
-    Serial.print(_motors[i].getTargetPosition());
-    Serial.print(F(" Enabled:"));
-    Serial.print(_motors[i].isEnabled() ? F("YES") : F("NO"));
+    Output.print(F(" Pos:"));
+    Output.print(_motors[i].getCurrentPosition());
+    Output.print(F(" Target:"));
+    Output.print(_motors[i].getTargetPosition());
+    Output.print(F(" Enabled:"));
+    Output.print(_motors[i].isEnabled() ? F("YES") : F("NO"));
     
     if (_motors[i].isCalibrated()) {
-      Serial.print(F(" Home:"));
-      Serial.print(_motors[i].getHomePosition());
-      Serial.print(F(" Min:"));
-      Serial.print(_motors[i].getMinPosition());
-      Serial.print(F(" Max:"));
-      Serial.print(_motors[i].getMaxPosition());
+      Output.print(F(" Home:"));
+      Output.print(_motors[i].getHomePosition());
+      Output.print(F(" Min:"));
+      Output.print(_motors[i].getMinPosition());
+      Output.print(F(" Max:"));
+      Output.print(_motors[i].getMaxPosition());
+    }
+    
+    Output.println();
+  }
+}
+
+void StepperController::printStats() {
+  _stats.print(Output, _motorCount);
+  Output.print(F("Trajectory underruns: "));
+  Output.println(_trajectory.getUnderruns());
+}
+
+RuntimeStats* StepperController::getStats() {
+  return &_stats;
+}
+
+Telemetry* StepperController::getTelemetry() {
+  return &_telemetry;
+}
+
+// Call after the defaults are set; saving starts from here on
+bool StepperController::loadConfig() {
+  return _config.load();
+}
+
+ConfigStore* StepperController::getConfig() {
+  return &_config;
+}
+
+static void printMemoryLine(const __FlashStringHelper* name, unsigned long bytes) {
+  Output.print(name);
+  Output.print(F(": "));
+  Output.println(bytes);
+}
+
+#ifdef __AVR__
+extern char __heap_start;
+extern char* __brkval;
+
+// Gap between the top of the heap (or the end of static data) and the stack
+static int freeMemory() {
+  char top;
+  return &top - (__brkval ? __brkval : &__heap_start);
+}
+#endif
+
+void StepperController::printMemory() {
+  Output.println(F("-- Memory (bytes) --"));
+  printMemoryLine(F("Motors"), sizeof(_motors));
+  printMemoryLine(F("Planner"), sizeof(_planner));
+  printMemoryLine(F("Coordinated move"), sizeof(_coordinatedMove));
+  printMemoryLine(F("Trajectory"), sizeof(_trajectory));
+  printMemoryLine(F("Telemetry"), sizeof(_telemetry));
+  printMemoryLine(F("Stats"), sizeof(_stats));
+  printMemoryLine(F("Binary decoder"), sizeof(_binary));
+  printMemoryLine(F("Config store"), sizeof(_config));
+  printMemoryLine(F("Mailbox"), sizeof(_mailbox));
+  printMemoryLine(F("Controller total"), sizeof(StepperController));
+  printMemoryLine(F("Output buffer"), sizeof(OutputBuffer));
+  printMemoryLine(F("Step timer"), sizeof(StepTimer));
+  
+  Output.print(F("Per motor: "));
+  Output.print(sizeof(Motor));
+  Output.print(F(" x "));
+  Output.print(MAX_MOTORS);
+  Output.print(F(" slots, "));
+  Output.print(_motorCount);
+  Output.println(F(" used"));
+  
+#ifdef __AVR__
+  printMemoryLine(F("Free"), freeMemory());
+#endif
+}
+
+void StepperController::printRampTables() {
+  uint16_t total = 0;
+  
+  Output.println(F("-- Ramp Tables --"));
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    RampTable* ramp = _motors[i].getRampTable();
+    total += ramp->getMemoryUsage();
+    
+    Output.print(F("Motor "));
+    Output.print(i);
+    
+    if (!ramp->isValid()) {
+      Output.println(F(": not built"));
+      continue;
     }
     
-    Serial.println();
+    Output.print(F(": Ramp:"));
+    Output.print(ramp->getRampSteps());
+    Output.print(F(" Stride:"));
+    Output.print(ramp->getStride());
+    Output.print(F(" Entries:"));
+    Output.print(ramp->getEntryCount());
+    Output.print(F(" Bytes:"));
+    Output.println(ramp->getMemoryUsage());
   }
+  
+  Output.print(F("Total bytes: "));
+  Output.println(total);
 }
 
 void StepperController::update() {
+  unsigned long period = _stats.recordUpdate(micros());
+  
+  // Only the newest target is applied, and not while a retarget is still settling
+  if (_mailbox.isDue(micros()) && !_coordinatedMove.isRetargeting()) {
+    flushMailbox();
+  }
+  
   if (!_emergencyStop) {
     runAll();
   }
+  
+  recordSteps(period);
+  
+  if (_telemetry.isDue()) {
+    _telemetry.capture(getTelemetryFlags());
+  }
+  _telemetry.send();
+  
+  _config.update(_activeMask == 0);
+  
+  Output.drain();
+}
+
+uint8_t StepperController::getTelemetryFlags() {
+  return (_emergencyStop ? TELEMETRY_EMERGENCY_STOP : 0) |
+         (_coordinatedMove.isActive() ? TELEMETRY_COORDINATED : 0) |
+         (!_planner.isEmpty() ? TELEMETRY_QUEUED : 0) |
+         (_trajectory.isActive() ? TELEMETRY_TRAJECTORY : 0);
+}
+
+// A polled step is late when it was due more than STATS_LATE_STEP_US before this update
+void StepperController::recordSteps(unsigned long period) {
+  for (uint8_t i = 0; i < _motorCount; i++) {
+    long shift = _motors[i].takePositionShift();
+    if (shift) {
+      _stats.shiftPosition(i, shift);
+    }
+    _stats.recordPosition(i, _motors[i].getCurrentPosition());
+    
+    unsigned long latency = _motors[i].takeJogLatency();
+    if (latency) {
+      _stats.recordJogLatency(i, latency);
+    }
+    
+    if (period > STATS_LATE_STEP_US && _motors[i].isRunning() && !_motors[i].isTimerDriven()) {
+      if ((period - STATS_LATE_STEP_US) * fabs(_motors[i].getSpeed()) >= 1000000.0) {
+        _stats.recordLateStep(i);
+      }
+    }
+  }
 }
 
 bool StepperController::processCommand(const char* command) {
+  unsigned long start = micros();
+  bool handled = dispatchCommand(command);
+  _stats.recordCommand(micros() - start);
+  return handled;
+}
+
+bool StepperController::dispatchCommand(const char* command) {
   char cmd[COMMAND_BUFFER_SIZE];
   strncpy(cmd, command, COMMAND_BUFFER_SIZE - 1);
   cmd[COMMAND_BUFFER_SIZE - 1] = '\0';
@@ -171,433 +617,397 @@ bool StepperController::processCommand(const char* command) {
   char* token = strtok(cmd, " ");
   if (!token) return false;
   
-  String cmdStr = String(token);
-  cmdStr.toLowerCase();
-  
-  if (cmdStr == "help") {
-    Serial.println(F("Available commands:"));
-    Serial.println(F("help - Show this help message"));
-    Serial.println(F("status - Show motor status"));
-    Serial.println(F("enable <motor> - Enable motor (0-n)"));
-    Serial.println(F("disable <motor> - Disable motor (0-n)"));
-    Serial.println(F("enable_all - Enable all motors"));
-    Serial.println(F("disable_all - Disable all motors"));
-    Serial.println(F("move <motor> <steps> - Move motor by steps"));
-    Serial.println(F("moveto <motor> <position> - Move motor to absolute position"));
-    Serial.println(F("moveunit <motor> <unit> - Move motor by units"));
-    Serial.println(F("movetounit <motor> <position> - Move motor to absolute position in units"));
-    Serial.println(F("home <motor> - Home specific motor"));
-    Serial.println(F("home_all - Home all motors"));
-    Serial.println(F("stop <motor> - Stop specific motor"));
-    Serial.println(F("stop_all - Stop all motors"));
-    Serial.println(F("emergency_stop - Emergency stop all motors"));
-    Serial.println(F("resume - Resume after emergency stop"));
-    Serial.println(F("speed <motor> <speed> - Set maximum speed"));
-    Serial.println(F("accel <motor> <accel> - Set acceleration"));
-    Serial.println(F("calibrate_home <motor> - Calibrate home position"));
-    Serial.println(F("calibrate_min <motor> - Calibrate min position"));
-    Serial.println(F("calibrate_max <motor> - Calibrate max position"));
-    Serial.println(F("calibrate_home_all - Calibrate home position for all motors"));
-    Serial.println(F("calibrate_min_all - Calibrate min position for all motors"));
-    Serial.println(F("calibrate_max_all - Calibrate max position for all motors"));
-    Serial.println(F("invert <motor> <0|1> - Invert motor direction"));
-    Serial.println(F("set_steps_per_unit <motor> <factor> - Set steps per unit conversion factor"));
-    return true;
-  }
-  else if (cmdStr == "status") {
-    printStatus();
-    return true;
-  }
-  else if (cmdStr == "enable") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    _motors[motorIndex].enable();
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.println(F(" enabled"));
-    return true;
-  }
-  else if (cmdStr == "disable") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    _motors[motorIndex].disable();
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.println(F(" disabled"));
-    return true;
-  }
-  else if (cmdStr == "enable_all") {
-    enableAll();
-    Serial.println(F("All motors enabled"));
-    return true;
-  }
-  else if (cmdStr == "disable_all") {
-    disableAll();
-    Serial.println(F("All motors disabled"));
-    return true;
+  for (char* c = token; *c; c++) {
+    *c = tolower(*c);
   }
-  else if (cmdStr == "move") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing steps parameter"));
-      return false;
-    }
-    
-    long steps = atol(token);
-    _motors[motorIndex].move(steps);
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" moving "));
-    Serial.print(steps);
-    Serial.println(F(" steps"));
-    return true;
-  }
-  else if (cmdStr == "moveto") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing position parameter"));
-      return false;
-    }
-    
-    long position = atol(token);
-    _motors[motorIndex].moveTo(position);
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" moving to position "));
-    Serial.println(position);
-    return true;
-  }
-  else if (cmdStr == "moveunit") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing units parameter"));
-      return false;
-    }
-    
-    float units = atof(token);
-    _motors[motorIndex].moveUnit(units);
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" moving "));
-    Serial.print(units);
-    Serial.println(F(" units"));
-    return true;
-  }
-  else if (cmdStr == "movetounit") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing position parameter"));
-      return false;
-    }
-    
-    float position = atof(token);
-    _motors[motorIndex].moveToUnit(position);
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" moving to position "));
-    Serial.print(position);
-    Serial.println(F(" units"));
-    return true;
-  }
-  else if (cmdStr == "home") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    _motors[motorIndex].home();
-    Serial.print(F("Homing motor "));
-    Serial.println(motorIndex);
-    return true;
-  }
-  else if (cmdStr == "home_all") {
-    homeAll();
-    Serial.println(F("Homing all motors"));
-    return true;
-  }
-  else if (cmdStr == "stop") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    _motors[motorIndex].stop();
-    Serial.print(F("Stopped motor "));
-    Serial.println(motorIndex);
-    return true;
-  }
-  else if (cmdStr == "stop_all") {
-    stopAll();
-    Serial.println(F("Stopped all motors"));
-    return true;
-  }
-  else if (cmdStr == "emergency_stop") {
-    emergencyStop();
-    Serial.println(F("EMERGENCY STOP"));
-    return true;
-  }
-  else if (cmdStr == "resume") {
-    emergencyStop(true);
-    Serial.println(F("Resumed after emergency stop"));
-    return true;
-  }
-  else if (cmdStr == "speed") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing speed parameter"));
-      return false;
-    }
-    
-    float speed = atof(token);
-    _motors[motorIndex].setMaxSpeed(speed);
-    Serial.print(F("Set motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" speed to "));
-    Serial.println(speed);
-    return true;
-  }
-  else if (cmdStr == "accel") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing acceleration parameter"));
-      return false;
-    }
-    
-    float accel = atof(token);
-    _motors[motorIndex].setAcceleration(accel);
-    Serial.print(F("Set motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" acceleration to "));
-    Serial.println(accel);
-    return true;
-  }
-  else if (cmdStr == "calibrate_home") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    _motors[motorIndex].calibrateHome();
-    return true;
+  
+  CommandArgs args;
+  int8_t index = findCommand(token);
+  
+  // Commands that are not absolute targets run after the targets sent before them
+  if (index < 0 || isMailboxBarrier(index)) {
+    flushMailbox();
   }
-  else if (cmdStr == "calibrate_min") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
+  
+  if (index >= 0) {
+    char schema[COMMAND_SCHEMA_SIZE];
+    readCommandSchema(index, schema);
     
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
+    if (!parseArguments(schema, args)) {
+      printCommandUsage(Output, index);
       return false;
     }
-    
-    _motors[motorIndex].calibrateMin();
-    return true;
+    return readCommandHandler(index)(*this, args);
   }
-  else if (cmdStr == "calibrate_max") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
+  
+  for (uint8_t i = 0; i < _userCommandCount; i++) {
+    if (strcmp(token, _userCommands[i].name) == 0) {
+      if (!parseArguments(_userCommands[i].schema, args)) {
+        if (_userCommands[i].help) {
+          Output.print(F("Usage: "));
+          Output.println(_userCommands[i].help);
+        }
+        return false;
+      }
+      return _userCommands[i].handler(*this, args);
     }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
+  }
+  
+  Output.print(F("Unknown command: "));
+  Output.println(token);
+  return false;
+}
+
+bool StepperController::parseArguments(const char* schema, CommandArgs& args) {
+  args.motor = 0;
+  args.value = 0;
+  args.number = 0.0;
+  args.numberCount = 0;
+  args.count = 0;
+  
+  for (const char* type = schema; *type; type++) {
+    uint8_t count = 1;
+    if (*type == 'A' || *type == 'F') count = _motorCount;
+    if (*type == 'P') count = _motorCount * 2;
+    
+    for (uint8_t i = 0; i < count; i++) {
+      char* token = strtok(NULL, " ");
+      
+      if (!token) {
+        if (*type == 'm') {
+          Output.println(F("Error: Missing motor index parameter"));
+        }
+        else {
+          Output.println(F("Error: Missing parameter"));
+        }
+        return false;
+      }
+      
+      switch (*type) {
+        case 'm': {
+          int motorIndex = atoi(token);
+          if (motorIndex < 0 || motorIndex >= _motorCount) {
+            Output.println(F("Error: Invalid motor index"));
+            return false;
+          }
+          args.motor = motorIndex;
+          break;
+        }
+        case 'l':
+        case 'b':
+          args.value = atol(token);
+          break;
+        case 'f':
+          args.number = atof(token);
+          if (args.numberCount < COMMAND_MAX_NUMBERS) {
+            args.numbers[args.numberCount++] = args.number;
+          }
+          break;
+        case 'A':
+        case 'F':
+        case 'P': {
+          char* end;
+          if (*type == 'A' || (*type == 'P' && i % 2 == 0)) {
+            args.values[args.count] = strtol(token, &end, 10);
+          }
+          else {
+            args.reals[args.count] = strtod(token, &end);
+          }
+          
+          if (*type != 'P' || i % 2 == 1) {
+            args.count++;
+          }
+          
+          if (*end != '\0') {
+            Output.println(F("Error: Invalid number"));
+            return false;
+          }
+          break;
+        }
+      }
+    }
+    
+    // Per-motor lists must match the motor count exactly
+    if ((*type == 'A' || *type == 'F' || *type == 'P') && strtok(NULL, " ")) {
+      Output.println(F("Error: Too many parameters"));
       return false;
     }
-    
-    _motors[motorIndex].calibrateMax();
-    return true;
   }
-  else if (cmdStr == "calibrate_home_all") {
-    calibrateHomeAll();
-    return true;
+  
+  return true;
+}
+
+bool StepperController::registerCommand(const char* name, const char* schema, CommandHandler handler, const char* help) {
+  if (_userCommandCount >= MAX_USER_COMMANDS || findCommand(name) >= 0) {
+    return false;
+  }
+  
+  UserCommand& command = _userCommands[_userCommandCount++];
+  command.name = name;
+  command.schema = schema;
+  command.help = help;
+  command.handler = handler;
+  return true;
+}
+
+void StepperController::printHelp() {
+  Output.println(F("Available commands:"));
+  printCommandHelp(Output);
+  
+  for (uint8_t i = 0; i < _userCommandCount; i++) {
+    Output.println(_userCommands[i].help ? _userCommands[i].help : _userCommands[i].name);
   }
-  else if (cmdStr == "calibrate_min_all") {
-    calibrateMinAll();
-    return true;
+}
+
+void StepperController::setBinaryMode(bool enabled) {
+  _binaryMode = enabled;
+  _binary.reset();
+}
+
+bool StepperController::isBinaryMode() {
+  return _binaryMode;
+}
+
+void StepperController::processBinaryByte(uint8_t data) {
+  if (_binary.feed(data)) {
+    unsigned long start = micros();
+    handleBinaryFrame();
+    _stats.recordCommand(micros() - start);
   }
-  else if (cmdStr == "calibrate_max_all") {
-    calibrateMaxAll();
-    return true;
+}
+
+void StepperController::sendBinaryReply(uint8_t opcode, uint8_t status, const uint8_t* data, uint8_t length) {
+  uint8_t reply[BINARY_MAX_PAYLOAD];
+  
+  if (length > BINARY_MAX_PAYLOAD - 1) {
+    length = BINARY_MAX_PAYLOAD - 1;
   }
-  else if (cmdStr == "invert") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing invert parameter (0 or 1)"));
-      return false;
-    }
-    
-    bool invert = (atoi(token) != 0);
-    _motors[motorIndex].invertDirection(invert);
-    Serial.print(F("Motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" direction inverted: "));
-    Serial.println(invert ? F("YES") : F("NO"));
-    return true;
-  }
-  else if (cmdStr == "set_steps_per_unit") {
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing motor index parameter"));
-      return false;
-    }
-    
-    int motorIndex = atoi(token);
-    if (motorIndex < 0 || motorIndex >= _motorCount) {
-      Serial.println(F("Error: Invalid motor index"));
-      return false;
-    }
-    
-    token = strtok(NULL, " ");
-    if (!token) {
-      Serial.println(F("Error: Missing steps per unit parameter"));
-      return false;
-    }
-    
-    float stepsPerUnit = atof(token);
-    if (stepsPerUnit <= 0) {
-      Serial.println(F("Error: Steps per unit must be positive"));
-      return false;
-    }
-    
-    _motors[motorIndex].setStepsPerUnit(stepsPerUnit);
-    Serial.print(F("Set motor "));
-    Serial.print(motorIndex);
-    Serial.print(F(" steps per unit to "));
-    Serial.println(stepsPerUnit);
-    return true;
+  
+  reply[0] = status;
+  for (uint8_t i = 0; i < length; i++) {
+    reply[i + 1] = data[i];
   }
   
-  Serial.print(F("Unknown command: "));
-  Serial.println(cmdStr);
-  return false;
+  BinaryProtocol::send(Output, opcode | OP_REPLY, reply, length + 1);
 }
+
+void StepperController::handleBinaryFrame() {
+  if (_binary.hasCrcError()) {
+    sendBinaryReply(OP_CRC_ERROR, STATUS_CRC_ERROR);
+    return;
+  }
+  
+  uint8_t opcode = _binary.getOpcode();
+  uint8_t length = _binary.getLength();
+  const uint8_t* payload = _binary.getPayload();
+  uint8_t status = STATUS_OK;
+  
+  if (opcode != OP_MOVE_TO && opcode != OP_MOVE_TO_ALL && opcode != OP_POSE &&
+      opcode != OP_POSE_QUATERNION && opcode != OP_EMERGENCY_STOP) {
+    flushMailbox();
+  }
+  
+  switch (opcode) {
+    case OP_PING:
+      break;
+      
+    case OP_MOVE_TO:
+      if (length != 5 || payload[0] >= _motorCount) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      if (_mailbox.isEnabled() ? !postMove(payload[0], BinaryProtocol::readInt32(payload + 1))
+                               : !_motors[payload[0]].moveTo(BinaryProtocol::readInt32(payload + 1))) {
+        status = STATUS_LIMITED;
+      }
+      break;
+      
+    case OP_MOVE_TO_ALL:
+    case OP_QUEUE_MOVE: {
+      if (length != _motorCount * 4) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      
+      long targets[MAX_MOTORS];
+      for (uint8_t i = 0; i < _motorCount; i++) {
+        targets[i] = BinaryProtocol::readInt32(payload + i * 4);
+      }
+      
+      if (opcode == OP_MOVE_TO_ALL) {
+        if (!(_mailbox.isEnabled() ? postPath(targets) : moveToAll(targets))) {
+          status = _emergencyStop ? STATUS_BUSY : STATUS_INVALID_ARGUMENT;
+        }
+        break;
+      }
+      
+      if (!queueMove(targets)) {
+        status = STATUS_BUSY;
+      }
+      uint8_t free = getQueueFree();
+      sendBinaryReply(opcode, status, &free, 1);
+      return;
+    }
+    
+    case OP_POSE: {
+      if (length != 12) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      
+      long offsets[MAX_MOTORS];
+      uint16_t roll = (BinaryProtocol::readInt32(payload) * 2048L) / 11250;
+      uint16_t pitch = (BinaryProtocol::readInt32(payload + 4) * 2048L) / 11250;
+      long heave = (BinaryProtocol::readInt32(payload + 8) * 32L) / 125;
+      
+      _kinematics.solveEuler(roll, pitch, heave, _motorCount, offsets);
+      if (!applyPose(offsets)) {
+        status = _emergencyStop ? STATUS_BUSY : STATUS_INVALID_ARGUMENT;
+      }
+      break;
+    }
+    
+    case OP_POSE_QUATERNION: {
+      if (length != 12) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      
+      long offsets[MAX_MOTORS];
+      long heave = (BinaryProtocol::readInt32(payload + 8) * 32L) / 125;
+      
+      _kinematics.solveQuaternion(BinaryProtocol::readInt16(payload), BinaryProtocol::readInt16(payload + 2),
+                                  BinaryProtocol::readInt16(payload + 4), BinaryProtocol::readInt16(payload + 6),
+                                  heave, _motorCount, offsets);
+      if (!applyPose(offsets)) {
+        status = _emergencyStop ? STATUS_BUSY : STATUS_INVALID_ARGUMENT;
+      }
+      break;
+    }
+    
+    case OP_SET_SPEED:
+    case OP_SET_ACCEL:
+      if (length != 5 || payload[0] >= _motorCount) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      if (opcode == OP_SET_SPEED) {
+        _motors[payload[0]].setMaxSpeed(BinaryProtocol::readFloat(payload + 1));
+      }
+      else {
+        _motors[payload[0]].setAcceleration(BinaryProtocol::readFloat(payload + 1));
+      }
+      break;
+      
+    case OP_STOP:
+      if (length != 1 || payload[0] >= _motorCount) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      _motors[payload[0]].stop();
+      break;
+      
+    case OP_STOP_ALL:
+      stopAll();
+      break;
+      
+    case OP_EMERGENCY_STOP:
+      emergencyStop();
+      break;
+      
+    case OP_RESUME:
+      emergencyStop(true);
+      break;
+      
+    case OP_ENABLE:
+      if (length != 2 || payload[0] >= _motorCount) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      _motors[payload[0]].enable(payload[1] != 0);
+      break;
+      
+    case OP_STATUS: {
+      uint8_t data[BINARY_MAX_PAYLOAD - 1];
+      uint8_t count = _motorCount;
+      uint8_t running = 0;
+      
+      if (count > (BINARY_MAX_PAYLOAD - 3) / 4) {
+        count = (BINARY_MAX_PAYLOAD - 3) / 4;
+      }
+      
+      data[0] = count;
+      for (uint8_t i = 0; i < count; i++) {
+        BinaryProtocol::writeInt32(data + 1 + i * 4, _motors[i].getCurrentPosition());
+        if (_motors[i].isRunning()) {
+          running |= (1 << i);
+        }
+      }
+      data[1 + count * 4] = running;
+      
+      sendBinaryReply(opcode, status, data, count * 4 + 2);
+      return;
+    }
+    
+    case OP_WAYPOINT: {
+      uint8_t axes = _trajectory.getAxisCount();
+      if (length != 2 + axes * 8) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      
+      long positions[TRAJECTORY_AXES];
+      float velocities[TRAJECTORY_AXES];
+      for (uint8_t i = 0; i < axes; i++) {
+        positions[i] = BinaryProtocol::readInt32(payload + 2 + i * 8);
+        velocities[i] = BinaryProtocol::readFloat(payload + 6 + i * 8);
+      }
+      
+      if (!pushWaypoint(positions, velocities, (uint16_t)BinaryProtocol::readInt16(payload))) {
+        status = STATUS_BUSY;
+      }
+      
+      // Free credits, then the underrun count so the host can see it fell behind
+      uint16_t underruns = _trajectory.getUnderruns();
+      uint8_t data[3] = {getTrajectoryFree(), (uint8_t)(underruns & 0xFF), (uint8_t)(underruns >> 8)};
+      sendBinaryReply(opcode, status, data, sizeof(data));
+      return;
+    }
+    
+    case OP_JOG: {
+      if (length != _motorCount * 4) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      
+      float velocities[MAX_MOTORS];
+      for (uint8_t i = 0; i < _motorCount; i++) {
+        velocities[i] = BinaryProtocol::readFloat(payload + i * 4);
+      }
+      
+      if (!jogAll(velocities)) {
+        status = STATUS_BUSY;
+      }
+      break;
+    }
+    
+    case OP_SUBSCRIBE:
+      if (length != 2) {
+        status = STATUS_INVALID_ARGUMENT;
+        break;
+      }
+      _telemetry.setInterval((uint16_t)BinaryProtocol::readInt16(payload));
+      break;
+      
+    case OP_TEXT_MODE:
+      sendBinaryReply(opcode, status);
+      setBinaryMode(false);
+      return;
+      
+    default:
+      status = STATUS_UNKNOWN_OPCODE;
+      break;
+  }
+  
+  sendBinaryReply(opcode, status);
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "../inc/Telemetry.hpp"
+#include "../inc/BinaryProtocol.hpp"
+
+Telemetry::Telemetry() {
+  _motors = NULL;
+  _motorCount = 0;
+  _interval = 0;
+  _lastFrame = 0;
+  _framesSent = 0;
+  _sending = false;
+  _stage = 0;
+  _crc = 0xFFFF;
+}
+
+void Telemetry::begin(Motor* motors, uint8_t motorCount) {
+  _motors = motors;
+  _motorCount = motorCount;
+}
+
+void Telemetry::setInterval(unsigned long intervalMs) {
+  if (intervalMs > 0 && intervalMs < TELEMETRY_MIN_INTERVAL) {
+    intervalMs = TELEMETRY_MIN_INTERVAL;
+  }
+  
+  _interval = intervalMs;
+  _lastFrame = millis() - intervalMs;
+}
+
+unsigned long Telemetry::getInterval() {
+  return _interval;
+}
+
+uint16_t Telemetry::getFramesSent() {
+  return _framesSent;
+}
+
+bool Telemetry::isDue() {
+  return _interval > 0 && !_sending && millis() - _lastFrame >= _interval;
+}
+
+void Telemetry::capture(uint8_t flags) {
+  unsigned long now = millis();
+  
+  // Keep the rate steady without bursting to catch up after a slow frame
+  _lastFrame = (now - _lastFrame < 2 * _interval) ? _lastFrame + _interval : now;
+  
+  _timestamp = now;
+  _flags = flags;
+  _count = _motorCount;
+  
+  for (uint8_t i = 0; i < _count; i++) {
+    Motor& motor = _motors[i];
+    _position[i] = motor.getCurrentPosition();
+    _target[i] = motor.getTargetPosition();
+    _state[i] = (motor.isRunning() ? TELEMETRY_RUNNING : 0) |
+                (motor.isEnabled() ? TELEMETRY_ENABLED : 0) |
+                (motor.isExternallyDriven() ? TELEMETRY_EXTERNAL : 0) |
+                (motor.isCalibrated() ? TELEMETRY_CALIBRATED : 0);
+  }
+  
+  _sending = true;
+  _stage = 0;
+}
+
+void Telemetry::writeByte(uint8_t data) {
+  Output.write(data);
+  _crc = BinaryProtocol::crc16(_crc, data);
+}
+
+void Telemetry::writeInt32(int32_t value) {
+  writeByte(value & 0xFF);
+  writeByte((value >> 8) & 0xFF);
+  writeByte((value >> 16) & 0xFF);
+  writeByte((value >> 24) & 0xFF);
+}
+
+// Stage 0 is the header, stages 1..count the motors and the last stage the CRC
+void Telemetry::send() {
+  if (!_sending) return;
+  
+  if (_stage == 0) {
+    if (Output.getFree() < TELEMETRY_HEADER_SIZE + 3) return;
+    
+    Output.write(BINARY_SYNC_BYTE);
+    _crc = 0xFFFF;
+    writeByte(TELEMETRY_HEADER_SIZE + _count * TELEMETRY_MOTOR_SIZE);
+    writeByte(OP_TELEMETRY);
+    writeInt32(_timestamp);
+    writeByte(_flags);
+    writeByte(_count);
+  }
+  else if (_stage <= _count) {
+    if (Output.getFree() < TELEMETRY_MOTOR_SIZE) return;
+    
+    uint8_t i = _stage - 1;
+    writeInt32(_position[i]);
+    writeInt32(_target[i]);
+    writeByte(_state[i]);
+  }
+  else {
+    if (Output.getFree() < 2) return;
+    
+    Output.write((uint8_t)(_crc & 0xFF));
+    Output.write((uint8_t)(_crc >> 8));
+    _sending = false;
+    _framesSent++;
+    return;
+  }
+  
+  _stage++;
+}
@@ -0,0 +1,182 @@
+#include "../inc/Trajectory.hpp"
+
+Trajectory::Trajectory() {
+  _head = 0;
+  _count = 0;
+  _motors = NULL;
+  _axisCount = 0;
+  _active = false;
+  _holding = false;
+  _segmentStart = 0;
+  _lastFollow = 0;
+  _underruns = 0;
+}
+
+void Trajectory::begin(Motor* motors, uint8_t axisCount) {
+  _motors = motors;
+  _axisCount = axisCount > TRAJECTORY_AXES ? TRAJECTORY_AXES : axisCount;
+  clear();
+}
+
+bool Trajectory::push(const long positions[], const float velocities[], uint16_t duration) {
+  if (_count >= TRAJECTORY_QUEUE_SIZE || !_motors || duration == 0) {
+    return false;
+  }
+  
+  Waypoint& point = _points[(_head + _count) % TRAJECTORY_QUEUE_SIZE];
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    point.position[i] = _motors[i].limitPosition(positions[i]);
+    point.velocity[i] = velocities[i];
+  }
+  point.duration = duration;
+  _count++;
+  
+  return true;
+}
+
+void Trajectory::start() {
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _from[i] = _motors[i].getCurrentPosition();
+    _fromVelocity[i] = 0.0;
+    _motors[i].beginExternal(_points[_head].position[i]);
+  }
+  
+  _segmentStart = micros();
+  _lastFollow = _segmentStart - TRAJECTORY_INTERVAL_US;
+  _active = true;
+  _holding = false;
+}
+
+void Trajectory::run() {
+  if (!_active) {
+    if (_count == 0) return;
+    start();
+  }
+  
+  unsigned long now = micros();
+  
+  if (now - _lastFollow >= TRAJECTORY_INTERVAL_US) {
+    _lastFollow = now;
+    
+    // A waypoint that arrives while holding starts its segment from rest, now
+    if (_holding && _count > 0) {
+      _holding = false;
+      _segmentStart = now;
+      for (uint8_t i = 0; i < _axisCount; i++) {
+        _fromVelocity[i] = 0.0;
+      }
+    }
+    
+    // Each finished segment's end becomes the start of the next one
+    while (_count > 0 && now - _segmentStart >= _points[_head].duration * 1000UL) {
+      Waypoint& point = _points[_head];
+      _segmentStart += point.duration * 1000UL;
+      
+      for (uint8_t i = 0; i < _axisCount; i++) {
+        _from[i] = point.position[i];
+        _fromVelocity[i] = point.velocity[i];
+      }
+      
+      _head = (_head + 1) % TRAJECTORY_QUEUE_SIZE;
+      _count--;
+    }
+    
+    if (_count > 0) {
+      interpolate(now - _segmentStart);
+    }
+    else {
+      hold();
+      if (!_active) return;
+    }
+  }
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _motors[i].runSpeed();
+  }
+}
+
+void Trajectory::interpolate(unsigned long elapsed) {
+  Waypoint& point = _points[_head];
+  float length = point.duration * 1.0e-3;
+  float s = elapsed / (point.duration * 1000.0);
+  float s2 = s * s;
+  float s3 = s2 * s;
+  
+  // Hermite basis, with the start position factored out
+  float h10 = (s3 - 2.0 * s2 + s) * length;
+  float h01 = 3.0 * s2 - 2.0 * s3;
+  float h11 = (s3 - s2) * length;
+  float d01 = (6.0 * s - 6.0 * s2) / length;
+  float d00 = 3.0 * s2 - 4.0 * s + 1.0;
+  float d11 = 3.0 * s2 - 2.0 * s;
+  
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    float delta = point.position[i] - _from[i];
+    float v0 = _fromVelocity[i];
+    float v1 = point.velocity[i];
+    
+    long position = _from[i] + lround(h10 * v0 + h01 * delta + h11 * v1);
+    _motors[i].follow(position, d01 * delta + d00 * v0 + d11 * v1);
+  }
+}
+
+void Trajectory::hold() {
+  if (!_holding) {
+    _holding = true;
+    
+    for (uint8_t i = 0; i < _axisCount; i++) {
+      if (_fromVelocity[i] != 0.0) {
+        _underruns++;
+        break;
+      }
+    }
+  }
+  
+  bool settled = true;
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _motors[i].follow(_from[i], 0.0);
+    if (_motors[i].getCurrentPosition() != _from[i]) {
+      settled = false;
+    }
+  }
+  
+  if (settled) {
+    finish();
+  }
+}
+
+void Trajectory::finish() {
+  for (uint8_t i = 0; i < _axisCount; i++) {
+    _motors[i].setSpeed(0.0);
+    _motors[i].runSpeed();
+    _motors[i].endExternal();
+  }
+  
+  _active = false;
+  _holding = false;
+}
+
+void Trajectory::clear() {
+  if (_active) {
+    finish();
+  }
+  
+  _head = 0;
+  _count = 0;
+}
+
+bool Trajectory::isActive() {
+  return _active;
+}
+
+uint8_t Trajectory::getFree() {
+  return TRAJECTORY_QUEUE_SIZE - _count;
+}
+
+uint8_t Trajectory::getAxisCount() {
+  return _axisCount;
+}
+
+uint16_t Trajectory::getUnderruns() {
+  return _underruns;
+}
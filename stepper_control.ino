@@ -10,10 +10,10 @@ void setup() {
   Serial.println(F("Stepper Motor Controller"));
   Serial.println(F("Type 'help' for available commands"));
   
-  uint8_t xMotor = controller.addMotor(X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN, MOTOR_INTERFACE_TYPE);
-  uint8_t yMotor = controller.addMotor(Y_STEP_PIN, Y_DIR_PIN, Y_ENABLE_PIN, MOTOR_INTERFACE_TYPE);
-  uint8_t zMotor = controller.addMotor(Z_STEP_PIN, Z_DIR_PIN, Z_ENABLE_PIN, MOTOR_INTERFACE_TYPE);
-  uint8_t aMotor = controller.addMotor(A_STEP_PIN, A_DIR_PIN, A_ENABLE_PIN, MOTOR_INTERFACE_TYPE);
+  uint8_t xMotor = controller.addMotor<X_STEP_PIN, X_DIR_PIN, X_ENABLE_PIN>();
+  uint8_t yMotor = controller.addMotor<Y_STEP_PIN, Y_DIR_PIN, Y_ENABLE_PIN>();
+  uint8_t zMotor = controller.addMotor<Z_STEP_PIN, Z_DIR_PIN, Z_ENABLE_PIN>();
+  uint8_t aMotor = controller.addMotor<A_STEP_PIN, A_DIR_PIN, A_ENABLE_PIN>();
   
   for (uint8_t i = 0; i < controller.getMotorCount(); i++) {
     Motor* motor = controller.getMotor(i);
@@ -22,6 +22,14 @@ void setup() {
     motor->setStepsPerUnit(DEFAULT_STEPS_PER_UNIT);
   }
   
+  // Calibration and settings from the last session replace the defaults
+  unsigned long restoreStart = micros();
+  if (controller.loadConfig()) {
+    Serial.print(F("Configuration restored in "));
+    Serial.print(micros() - restoreStart);
+    Serial.println(F(" us"));
+  }
+  
   Serial.print(F("Initialized "));
   Serial.print(controller.getMotorCount());
   Serial.println(F(" motors"));
@@ -36,17 +44,27 @@ void loop() {
 }
 
 void processSerialInput() {
+  // A full receive buffer means bytes may already have been lost
+  if (Serial.available() >= SERIAL_RX_BUFFER_SIZE - 1) {
+    controller.getStats()->recordRxOverflow();
+  }
+  
   while (Serial.available() > 0) {
     char c = Serial.read();
     
+    if (controller.isBinaryMode()) {
+      controller.processBinaryByte(c);
+      continue;
+    }
+    
     if (c == '\n' || c == '\r') {
       if (cmdIndex > 0) {
         cmdBuffer[cmdIndex] = '\0';
         
         if (!controller.processCommand(cmdBuffer)) {
-          Serial.print(F("Invalid command: "));
-          Serial.println(cmdBuffer);
-          Serial.println(F("Type 'help' for available commands"));
+          Output.print(F("Invalid command: "));
+          Output.println(cmdBuffer);
+          Verbose.println(F("Type 'help' for available commands"));
         }
         
         cmdIndex = 0;
@@ -55,12 +73,12 @@ void processSerialInput() {
     else if (c == 8 || c == 127) {
       if (cmdIndex > 0) {
         cmdIndex--;
-        Serial.print(F("\b \b"));
+        Verbose.print(F("\b \b"));
       }
     }
     else if (cmdIndex < COMMAND_BUFFER_SIZE - 1) {
       cmdBuffer[cmdIndex++] = c;
-      Serial.write(c);
+      Verbose.write(c);
     }
   }
 }